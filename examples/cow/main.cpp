@@ -37,10 +37,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "renderer/geometry_processor.h"
 #include "renderer/rasterizer_subdivaffine.h"
 #include "renderer/span.h"
+#include "renderer/framebuffer.h"
 
 // other includes
 #include "util/vector_math.h"
 #include "util/objdata.h"
+#include "util/meshfile.h"
+#include "util/meshopt.h"
 #include "fixedpoint/fixed_class.h"
 
 #include <vector>
@@ -67,12 +70,20 @@ typedef mat2<fixed16_t> mat2x;
 typedef mat3<fixed16_t> mat3x;
 typedef mat4<fixed16_t> mat4x;
 
+// Define this to 1 to render from quantized vertices (12 bytes per vertex
+// instead of 32). They are decoded in the vertex shader.
+#define USE_QUANTIZED_VERTICES 1
+
 // vertex structure which will be used to store per vertex data which
 // is passed to the vertex shader.
+#if USE_QUANTIZED_VERTICES
+typedef QuantizedVertex MyVertex;
+#else
 struct MyVertex {
 	vec3x position;
 	vec3x normal;
 };
+#endif
 
 // this is the vertex shader which is executed for each individual vertex that
 // needs to be processed.
@@ -86,10 +97,24 @@ struct MyVertexShader {
 	// this information is used for clipping purposes.
 	static const unsigned varying_count = 1;
 
+	// the constant data of the shader. declaring uniform_type makes the
+	// geometry processor pass the data set with GeometryProcessor::uniforms
+	// to the shade function, so there is no need for static variables.
+	struct Uniforms {
+		mat4x model_view_projection_matrix;
+		vec3x light_dir;
+
+		// decoding parameters for the quantized positions
+		vec3x position_offset;
+		vec3x position_scale;
+	};
+	typedef Uniforms uniform_type;
+
 	// this static function is called for each vertex to be processed.
 	// "in" is an array of void* pointers with the location of the individial 
 	// vertex attributes. the "out" structure has to be written to.
-	static void shade(const GeometryProcessor::VertexInput in, GeometryProcessor::VertexOutput &out)
+	static void shade(const GeometryProcessor::VertexInput in, GeometryProcessor::VertexOutput &out,
+		const Uniforms &u)
 	{
 		// some constants used
 		static const fixed16_t half = 0.5f;
@@ -98,8 +123,17 @@ struct MyVertexShader {
 		// cast the first attribute array to the input vertex type.
 		const MyVertex &v = *static_cast<const MyVertex*>(in[0]);
 
+	#if USE_QUANTIZED_VERTICES
+		// decode the position and the normal
+		const vec3x position = dequantize(v.position, u.position_offset, u.position_scale);
+		const vec3x normal = oct_decode<fixed16_t>(v.normal);
+	#else
+		const vec3x &position = v.position;
+		const vec3x &normal = v.normal;
+	#endif
+
 		// transform the vertex by the transformation matrix
-		vec4x t = model_view_projection_matrix_ * vec4x(v.position, one);
+		vec4x t = u.model_view_projection_matrix * vec4x(position, one);
 
 		// x, y, z and w are the components that must be written by the vertex
 		// shader. they all have to be specified in 16.16 fixed point format.
@@ -110,26 +144,15 @@ struct MyVertexShader {
 
 		// calculate the lighting. doing it this way we will also get some nice
 		// shading on the back side of the model.
-		fixed16_t lighting = dot(v.normal, light_dir_) * half + half;
+		fixed16_t lighting = dot(normal, u.light_dir) * half + half;
 		
 		// write the varying which will be interpolated across the triangle.
 		out.varyings[0] = 31 * lighting.intValue;
 	}
-
-	// variables the shader will use.
-	static vec3x light_dir_;
-	static mat4x model_view_projection_matrix_;
 };
 
-// define the vertex shader variables so the linker does not complain.
-vec3x MyVertexShader::light_dir_= normalize<fixed16_t>(vec3x(10.0f, 10.0f, 10.f));
-mat4x MyVertexShader::model_view_projection_matrix_;
-
-// global depth buffer we will use.
-SDL_Surface * depth_buffer;
-
-// global drawing surface.
-SDL_Surface * shadow;
+// global color and depth buffer we will render to.
+Framebuffer *screen_buffer;
 
 #define USE_GENERIC_SPAN_DRAWER 0
 
@@ -137,7 +160,7 @@ SDL_Surface * shadow;
 #if USE_GENERIC_SPAN_DRAWER
 struct MyFragmentShader : public GenericSpanDrawer<MyFragmentShader> {
 #else
-struct MyFragmentShader : public SpanDrawer16BitColorAndDepth<MyFragmentShader> {
+struct MyFragmentShader : public SpanDrawerFramebuffer<MyFragmentShader> {
 #endif
 	// varying_count = 1 tells the rasterizer that it only needs to interpolate
 	// one varying value which will be the lighting value computed per vertex.
@@ -165,9 +188,11 @@ struct MyFragmentShader : public SpanDrawer16BitColorAndDepth<MyFragmentShader>
 	// this one is to be used with the GenericSpanDrawer
 	static void single_fragment(int x, int y, const IRasterizer::FragmentData &fd, void *userdata)
 	{
+		// the framebuffer is cleared lazily, so make sure the pixel is valid.
+		screen_buffer->touch(x, y, 1);
+
 		// get the depth buffer pixel from x, y parameters.
-		unsigned short *db = static_cast<unsigned short*>(depth_buffer->pixels) +
-			x + y * depth_buffer->w;
+		unsigned short *db = screen_buffer->depth_pointer(x, y);
 
 		// do the depth test (note: we have a 16bit depth buffer, therefore the shift).
 		unsigned short depth = fd.z >> 16;
@@ -175,8 +200,7 @@ struct MyFragmentShader : public SpanDrawer16BitColorAndDepth<MyFragmentShader>
 		*db = depth;
 
 		// get the color buffer pixel.
-		unsigned short *color_buffer = static_cast<unsigned short*>(shadow->pixels) + 
-			x + y * shadow->w;
+		unsigned short *color_buffer = screen_buffer->color_pointer(x, y);
 
 		// make sure the interpolated value lies in the correct range.
 		int s = std::min(std::max(fd.varyings[0] >> 16, 0), 31);
@@ -202,27 +226,14 @@ struct MyFragmentShader : public SpanDrawer16BitColorAndDepth<MyFragmentShader>
 		color = (s << 11) | (s << 6) | s;
 	}
 
-	// this is called by the span drawing function to get the location of the color buffer
-	static void* color_pointer(int x, int y, void *userdata)
-	{
-		return static_cast<unsigned short*>(shadow->pixels) + x + y * shadow->w;
-	}
-
-	// this is called by the span drawing function to get the location of the depth buffer
-	static void* depth_pointer(int x, int y, void *userdata)
+	// this is called by the span drawing function to get the framebuffer to draw to.
+	static Framebuffer& framebuffer(void *userdata)
 	{
-		return static_cast<unsigned short*>(depth_buffer->pixels) + x + y * depth_buffer->w;
+		return *screen_buffer;
 	}
 #endif
 };
 
-// conversion function used to convert the float vectors 
-// loaded from the .obj file to fixed point.
-inline vec3x convert(const vec3<float> & rhs)
-{
-	return vec3x(rhs.x, rhs.y, rhs.z);
-}
-
 // Define this to do rendering without blitting to the screen (shows real performance)
 // #define FPS_TEST
 
@@ -248,15 +259,10 @@ int main(int /*ac*/, char * /*av*/[])
 	// used to access GP2X buttons.
 	SDL_JoystickOpen(0);
 #endif
-	// we will render into the shadow surface and blit to the main screen at the end.
-	// doing it this way one can circumvent double buffering on the GP2X 
-	// and thus render faster.
-	shadow = SDL_DisplayFormat(screen);
-
-	// create a 16bit depth buffer. making it a hw surface will allow us 
-	// to do fast clears and using the mmuhack on the GP2X also gives us fast 
-	// access to the memory.
-	depth_buffer = SDL_CreateRGBSurface(SDL_HWSURFACE, width, height, 16, 0, 0, 0, 0);
+	// we will render into the framebuffer and copy it to the screen at the end.
+	// the framebuffer is only cleared where something is drawn, the rest of
+	// the screen is filled with the clear color when copying.
+	screen_buffer = new Framebuffer(width, height);
 
 #ifdef GP2X
 	gp2x_init();
@@ -276,6 +282,12 @@ int main(int /*ac*/, char * /*av*/[])
 
 	// set the vertex and fragment shaders.
 	g.vertex_shader<MyVertexShader>();
+
+	// the data of the vertex shader. the geometry processor only keeps a
+	// pointer, so changes are seen by the next draw call.
+	MyVertexShader::Uniforms uniforms;
+	uniforms.light_dir = normalize<fixed16_t>(vec3x(10.0f, 10.0f, 10.f));
+	g.uniforms(&uniforms);
 	r.fragment_shader<MyFragmentShader>();
 
 	// disable perspective correction for faster rendering.
@@ -283,26 +295,48 @@ int main(int /*ac*/, char * /*av*/[])
 	// are all small enough and we only use vertex colors and no textures.
 	r.perspective_correction(false);
 
-	std::vector<unsigned> idata;
-	std::vector<MyVertex> vdata;
+	// the first time the .obj file is converted to a binary mesh file which
+	// already contains the fixed point vertex data. after that the binary file
+	// is memory mapped and rendered from directly.
+#if USE_QUANTIZED_VERTICES
+	const MeshFile::VertexFormat format = MeshFile::FORMAT_QUANTIZED;
+#else
+	const MeshFile::VertexFormat format = MeshFile::FORMAT_FIXED16;
+#endif
 
-	{
-		ObjData mesh = ObjData::load_from_file("data/cow.obj");
-		std::vector<ObjData::VertexArrayData> vdata_tmp;
-		mesh.to_vertex_array(vdata_tmp, idata);
-		vdata.resize(vdata_tmp.size());
-		for (size_t i = 0; i < vdata_tmp.size(); ++i) {
-			vdata[i].position = convert(vdata_tmp[i].vertex);
-			vdata[i].normal = convert(vdata_tmp[i].normal);
-		}
+	MeshFile mesh;
+	if (!mesh.open("data/cow.swrm") || mesh.vertex_format() != format) {
+		ObjData obj = ObjData::load_from_file("data/cow.obj");
+		std::vector<ObjData::VertexArrayData> vdata;
+		std::vector<unsigned> idata;
+		obj.to_vertex_array(vdata, idata);
+
+		// reorder triangles and vertices for the vertex cache
+		std::vector<unsigned> remap;
+		meshopt::optimize_vertex_cache(&idata[0], idata.size(), vdata.size());
+		meshopt::optimize_vertex_fetch(remap, &idata[0], idata.size(), vdata.size());
+		meshopt::remap_vertices(vdata, remap);
+
+		// 16 bit indices if there are few enough vertices, which halves the
+		// memory traffic for index fetching.
+		mesh.create(vdata, idata, format);
+		if (!mesh.save("data/cow.swrm"))
+			std::cout << "could not write data/cow.swrm" << std::endl;
 	}
 
-	// specify where out data lies in memory.
-	g.vertex_attrib_pointer(0, sizeof(MyVertex), &vdata[0]);
+	// specify where out data lies in memory. the vertices in the mesh file
+	// start with the members of MyVertex.
+	g.vertex_attrib_pointer(0, mesh.vertex_stride(), mesh.vertices());
+
+#if USE_QUANTIZED_VERTICES
+	const QuantizationParams q = mesh.quantization();
+	uniforms.position_offset = vec3x(q.position_offset.x, q.position_offset.y, q.position_offset.z);
+	uniforms.position_scale = vec3x(q.position_scale.x, q.position_scale.y, q.position_scale.z);
+#endif
 
 	// output some information
-	std::cout << "vertices: " << vdata.size() << std::endl;
-	std::cout << "faces: " << idata.size() / 3 << std::endl;
+	std::cout << "vertices: " << mesh.vertex_count() << std::endl;
+	std::cout << "faces: " << mesh.index_count() / 3 << std::endl;
 
 	// rendering loop
 	while (true) {
@@ -314,42 +348,36 @@ int main(int /*ac*/, char * /*av*/[])
 			}
 		}
 
-		// clear the screen and the depth buffer.
-		#ifndef FPS_TEST
-			SDL_FillRect(shadow, 0, 0);
-			SDL_FillRect(depth_buffer, 0, 0xffffffff);
-		#endif
+		// clear the color and the depth buffer. this only marks the tiles of
+		// the framebuffer as cleared and is very cheap.
+		screen_buffer->clear(0, 0xffff);
 
 		// create a transformation depending on the time to rotate around the object.
 		fixed16_t time(SDL_GetTicks() / 1000.0f);
 		vec3x eye(cos(time) * fixed16_t(10.0f), 0.0f, sin(time) * fixed16_t(10.0f));
 
-		MyVertexShader::model_view_projection_matrix_ = 
+		uniforms.model_view_projection_matrix = 
 			perspective_matrix<fixed16_t>(60.0f, 4.0f/3.0f, 0.5f, 100.0f) *
 			lookat_matrix(eye, vec3x(0.0f), vec3x(0.0f, 1.0f, 0.0f));
 
-		// lock the surfaces as we want to directly write to them.
-		const int r1 = SDL_LockSurface(depth_buffer);
-		const int r2 = SDL_LockSurface(shadow);
-		
-		// draw the mesh by sending the vertex data to the pipeline (only when locking worked).
-		if (!r1 && !r2)	{
-			g.draw_triangles(idata.size(), &idata[0]);
-		#ifdef GP2X
-			flush_uppermem_cache(
-				shadow->pixels, 
-				static_cast<char*>(shadow->pixels) + shadow->pitch * shadow->h,
-				0);
-		#endif
-		}
-
-		// unlock them again.
-		if (!r2) SDL_UnlockSurface(shadow);
-		if (!r2) SDL_UnlockSurface(depth_buffer);
+		// draw the mesh by sending the vertex data to the pipeline.
+		if (mesh.indices16())
+			g.draw_triangles(mesh.index_count(), mesh.indices16());
+		else
+			g.draw_triangles(mesh.index_count(), mesh.indices32());
 
-		// blit shadow surface to screen and show the screen.
+		// copy the framebuffer to the screen and show the screen.
 		#ifndef FPS_TEST
-			SDL_BlitSurface(shadow, 0, screen, 0);
+			if (!SDL_LockSurface(screen)) {
+				screen_buffer->present(screen->pixels, screen->pitch);
+			#ifdef GP2X
+				flush_uppermem_cache(
+					screen->pixels, 
+					static_cast<char*>(screen->pixels) + screen->pitch * screen->h,
+					0);
+			#endif
+				SDL_UnlockSurface(screen);
+			}
 			SDL_Flip(screen);
 		#endif
 
@@ -367,9 +395,8 @@ int main(int /*ac*/, char * /*av*/[])
 		}
 	}
 end:
-	// free the created surfaces.
-	SDL_FreeSurface(shadow);
-	SDL_FreeSurface(depth_buffer);
+	// free the framebuffer.
+	delete screen_buffer;
 
 	// quit SDL.
 	SDL_Quit();
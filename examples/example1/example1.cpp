@@ -37,6 +37,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "renderer/geometry_processor.h"
 #include "renderer/rasterizer_subdivaffine.h"
 #include "renderer/span.h"
+#include "renderer/pixel_format.h"
+#include "renderer/framebuffer.h"
 
 // the software renderer stuff is located in the namespace "swr" so include 
 // that here
@@ -85,13 +87,16 @@ struct VertexShader {
 	}
 };
 
+// The framebuffer we render into. Its color plane is the screen surface.
+Framebuffer *screen_buffer;
+
 #define USE_GENERIC_SPAN_DRAWER 0
 
 // This is the fragment shader
 #if USE_GENERIC_SPAN_DRAWER
 struct FragmentShader : public GenericSpanDrawer<FragmentShader> {
 #else
-struct FragmentShader : public SpanDrawer16BitColorAndDepth<FragmentShader> {
+struct FragmentShader : public SpanDrawerFramebuffer<FragmentShader> {
 #endif
 	// varying_count = 3 tells the rasterizer that it only needs to interpolate
 	// three varying values (the r, g and b in this context).
@@ -118,9 +123,8 @@ struct FragmentShader : public SpanDrawer16BitColorAndDepth<FragmentShader> {
 	static void single_fragment(int x, int y, const IRasterizer::FragmentData &fd, void *userdata)
 	{
 		// get the location of the pixel
-		SDL_Surface *screen = SDL_GetVideoSurface();
-		unsigned short *color_buffer = static_cast<unsigned short*>(screen->pixels) + 
-			x + y * screen->w;
+		screen_buffer->touch(x, y, 1);
+		unsigned short *color_buffer = screen_buffer->color_pointer(x, y);
 
 		// Convert from 16.16 color format to [0,255]
 		// Here the colors are clamped to the range[0,255]. If this is not done
@@ -128,7 +132,7 @@ struct FragmentShader : public SpanDrawer16BitColorAndDepth<FragmentShader> {
 		int r = std::min(std::max(fd.varyings[0] >> 16, 0), 255);
 		int g = std::min(std::max(fd.varyings[1] >> 16, 0), 255);
 		int b = std::min(std::max(fd.varyings[2] >> 16, 0), 255);
-		*color_buffer = SDL_MapRGB(screen->format, r, g, b);
+		*color_buffer = RGB565::from_rgb(r, g, b);
 	}
 #else
 	
@@ -140,29 +144,19 @@ struct FragmentShader : public SpanDrawer16BitColorAndDepth<FragmentShader> {
 		unsigned short &depth,
 		void *userdata)
 	{
-		SDL_Surface *screen = SDL_GetVideoSurface();
-
 		// Convert from 16.16 color format to [0,255]
 		// Here the colors are clamped to the range[0,255]. If this is not done
 		// here we can get very small artifacts at the edges.
 		int r = std::min(std::max(fd.varyings[0] >> 16, 0), 255);
 		int g = std::min(std::max(fd.varyings[1] >> 16, 0), 255);
 		int b = std::min(std::max(fd.varyings[2] >> 16, 0), 255);
-		color = SDL_MapRGB(screen->format, r, g, b);
-	}
-
-	// this is called by the span drawing function to get the location of the color buffer
-	static void* color_pointer(int x, int y, void *userdata)
-	{
-		SDL_Surface *screen = SDL_GetVideoSurface();
-		return static_cast<unsigned short*>(screen->pixels) + x + y * screen->w;
+		color = RGB565::from_rgb(r, g, b);
 	}
 
-	// this is called by the span drawing function to get the location of the depth buffer
-	static void* depth_pointer(int x, int y, void *userdata)
+	// this is called by the span drawing function to get the framebuffer
+	static Framebuffer& framebuffer(void *userdata)
 	{
-		// We don't use a depth buffer
-		return 0;
+		return *screen_buffer;
 	}
 #endif
 };
@@ -182,6 +176,12 @@ int main(int ac, char *av[]) {
 	// The indices we need for rendering
 	unsigned indices[] = {0, 1, 2};
 
+	// Render directly into the screen surface which is 16 bit r5g6b5. We 
+	// don't use a depth buffer. Clearing only marks the framebuffer as cleared.
+	SDL_LockSurface(screen);
+	screen_buffer = new Framebuffer(screen->pixels, screen->w, screen->h, screen->pitch, false);
+	screen_buffer->clear(0, 0);
+
 	// Create a rasterizer class that will be used to rasterize primitives
 	RasterizerSubdivAffine r;
 	// Create a geometry processor class used to feed vertex data.
@@ -204,6 +204,10 @@ int main(int ac, char *av[]) {
 	// draw the triangle
 	g.draw_triangles(3, indices);
 
+	// Fill the rest of the screen with the clear color
+	screen_buffer->resolve();
+	SDL_UnlockSurface(screen);
+
 	// Show everything on screen
 	SDL_Flip(SDL_GetVideoSurface());
 
@@ -211,6 +215,8 @@ int main(int ac, char *av[]) {
 	SDL_Event e;
 	while (SDL_WaitEvent(&e) && e.type != SDL_QUIT);
 
+	delete screen_buffer;
+
 	// Quit SDL
 	SDL_Quit();
 	return 0;
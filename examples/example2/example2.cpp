@@ -39,6 +39,12 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "renderer/geometry_processor.h"
 #include "renderer/rasterizer_subdivaffine.h"
 #include "renderer/span.h"
+#include "renderer/texture.h"
+#include "renderer/compressed_texture.h"
+#include "renderer/framebuffer.h"
+
+// requires the util library for the ETC1 encoder
+#include "etc1.h"
 
 // the software renderer stuff is located in the namespace "swr" so include 
 // that here
@@ -50,64 +56,39 @@ struct Vertex {
 	float tx, ty;
 };
 
-// our texture class
-struct Texture {
-	SDL_Surface *surface;
-
-	unsigned w_log2, h_log2;
-	unsigned w_minus1, h_minus1;
- 
-	// create a texture from an SDL_Surface	
-	Texture(SDL_Surface *s) 
-	{
-		surface = s;
-
-		w_log2 = log2_of_pot(s->w);
-		h_log2 = log2_of_pot(s->h);
-
-		w_minus1 = s->w - 1;
-		h_minus1 = s->h - 1;
-	}
-
-	~Texture() 
-	{
-		SDL_FreeSurface(surface); 
-	}
-
-	// returns log2 of a number which is a power if two
-	unsigned log2_of_pot(unsigned v) const
-	{
-		unsigned r = 0;
-		while (!(v & 1)) {
-			v >>= 1;
-			++r;
-		}
-		return r;
-	}
-
-	// samples the texture using the given texture coordinate.
-	// the integer texture coordinate is given in the upper 16 bits of the x and y variables.
-	// it is NOT in the range [0.0, 1.0] but rather in the range of [0, width - 1] or [0, height - 1].
-	// texture coordinates outside this range are wrapped.
-	unsigned short sample_nearest(int x, int y) const
-	{
-		x >>= 16;
-		y >>= 16;
-		x &= w_minus1;
-		y &= h_minus1;
-		return *(static_cast<unsigned short*>(surface->pixels) + ((y << w_log2) + x));
-	}
-};
+// the texture class of the renderer with the pixel format used in this example.
+// the texels are stored in 4x4 tiles which makes sampling equally fast no 
+// matter how the texture is oriented on screen.
+// with the alpha test a r5g5a1b5 texture is used. Otherwise it is r5g6b5 
+// which can be filtered a whole span at a time with SIMD instructions.
+// with ETC1_TEXTURE defined the texture is compressed to ETC1 at load time 
+// and decoded to r5g6b5 while sampling. ETC1 has no alpha, so this can not be
+// combined with the alpha test.
+#if defined(ETC1_TEXTURE)
+typedef CompressedTexture<RGB565> Texture16;
+#elif defined(ALPHA_TEST)
+typedef Texture<R5G5A1B5, TiledLayout<4> > Texture16;
+#else
+typedef Texture<RGB565, TiledLayout<4> > Texture16;
+#endif
 
 // loads an image file using SDL_image and converts it to a r5g5a1b5 format.
 // this format can be directly copied to the screen and one can also use the 
-// embedded alpha bit for an alpha test.
-SDL_Surface* load_surface_r5g5a1b5(const char *filename)
+// embedded alpha bit for an alpha test. Without the alpha test the image is 
+// converted to r5g6b5.
+SDL_Surface* load_surface_16bit(const char *filename)
 {
+#ifdef ALPHA_TEST
 	const Uint32 rmask = 0xF800;
 	const Uint32 gmask = 0x7C0;
 	const Uint32 bmask = 0x1F;
 	const Uint32 amask = 0x20;
+#else
+	const Uint32 rmask = 0xF800;
+	const Uint32 gmask = 0x7E0;
+	const Uint32 bmask = 0x1F;
+	const Uint32 amask = 0;
+#endif
 
 	SDL_Surface *result = 0;
 	SDL_Surface *img = 0;
@@ -124,6 +105,32 @@ end:
 	return result;
 }
 
+#ifdef ETC1_TEXTURE
+// loads an image file using SDL_image and compresses it to ETC1 with all
+// mipmap levels.
+Texture16* load_texture_etc1(const char *filename)
+{
+	SDL_Surface *img = IMG_Load(filename);
+	if (!img) return 0;
+
+	// the encoder wants 8 bit channels with red in the lowest byte
+	SDL_Surface *dummy = SDL_CreateRGBSurface(0, 0, 0, 32, 0xFF, 0xFF00, 0xFF0000, 0);
+	SDL_Surface *surface = SDL_ConvertSurface(img, dummy->format, 0);
+	SDL_FreeSurface(dummy);
+	SDL_FreeSurface(img);
+
+	std::vector<uint8_t> data;
+	const int level_count = etc1_compress(static_cast<const uint32_t*>(surface->pixels), 
+		surface->w, surface->h, surface->pitch / 4, true, data);
+
+	Texture16 *texture = new Texture16();
+	texture->create(surface->w, surface->h, level_count, &data[0]);
+	SDL_FreeSurface(surface);
+
+	return texture;
+}
+#endif
+
 // this is the vertex shader which is executed for each individual vertex that
 // needs to ne processed.
 struct VertexShader {
@@ -151,21 +158,18 @@ struct VertexShader {
 		out.z = 0;
 		out.w = 1 << 16;
 
-		// bring the texture coordinates into the appropriate range for the rasterizer.
-		// this mean it has to be converted to fixed point and premultiplied with the width, height of the 
-		// texture minus 1. Doing this in the vertex shader saves us from doing this in the fragment shader 
-		// which makes things faster.
-		out.varyings[0] = static_cast<int>(v.tx * texture->w_minus1 * (1 << 16));
-		out.varyings[1] = static_cast<int>(v.ty * texture->h_minus1 * (1 << 16));
+		// the texture coordinates are passed on in 16.16 fixed point. they are
+		// normalized, so they work for every mipmap level of the texture.
+		out.varyings[0] = static_cast<int>(v.tx * (1 << 16));
+		out.varyings[1] = static_cast<int>(v.ty * (1 << 16));
 	}
-
-	static Texture *texture;
 };
 
-Texture *VertexShader::texture = 0;
+// the framebuffer we render into. Its color plane is the screen surface.
+Framebuffer *screen_buffer;
 
 // this is the fragment shader
-struct FragmentShader : public SpanDrawer16BitColorAndDepth<FragmentShader> {
+struct FragmentShader : public SpanDrawerFramebuffer<FragmentShader> {
 	// varying_count = 3 tells the rasterizer that it only needs to interpolate
 	// three varying values (the r, g and b in this context).
 	static const unsigned varying_count = 2;
@@ -173,54 +177,76 @@ struct FragmentShader : public SpanDrawer16BitColorAndDepth<FragmentShader> {
 	// we don't need to interpolate z in this example
 	static const bool interpolate_z = false;
 
-	// per triangle callback. This could for instance be used to select the 
-	// mipmap level of detail. We don't need it but it still needs to be defined
-	// for everything to work.
+	// per triangle callback. It is used to select the mipmap level from the
+	// size of the triangle on screen and in the texture.
 	static void begin_triangle(
 		const IRasterizer::Vertex& v1,
 		const IRasterizer::Vertex& v2,
 		const IRasterizer::Vertex& v3,
 		int area2,
 		void *userdata)
-	{}
+	{
+		level = texture->select_level(v1, v2, v3, area2, 0, 1);
+	}
 
+#if defined(ETC1_TEXTURE)
+	// sampling the compressed texture decodes whole blocks into the cache.
+	// this example renders with one thread, so one cache is enough.
+	static void single_fragment(const IRasterizer::FragmentData &fd, unsigned short &color, unsigned short &depth, void *userdata)
+	{
+		color = texture->sample_bilinear(fd.varyings[0], fd.varyings[1], level, cache);
+	}
+
+	static Texture16::Cache cache;
+#elif defined(ALPHA_TEST)
 	// the fragment shader is called for each pixel and has read/write access to 
 	// the destination color and depth buffers.
 	static void single_fragment(const IRasterizer::FragmentData &fd, unsigned short &color, unsigned short &depth, void *userdata)
 	{
 		// sample the texture and write the color information
-		unsigned short c = texture->sample_nearest(fd.varyings[0], fd.varyings[1]);
+		unsigned short c = texture->sample_bilinear(fd.varyings[0], fd.varyings[1], level);
 
-#	ifdef ALPHA_TEST
 		// do an alpha test and only write color if the test passed
-		if (c & (1 << 5)) {
+		if (c & R5G5A1B5::ALPHA_BIT) {
 			// write the color
 			color = c; 
 		}
-#	else
-		// always write the color;
-		color = c;
-#	endif
 	}
-
-	// this is called by the span drawing function to get the location of the color buffer
-	static void* color_pointer(int x, int y, void *userdata)
+#else
+	// without the alpha test every pixel of a span is written. so instead of
+	// calling single_fragment for every pixel the whole span is filtered at 
+	// once directly into the color buffer. this replaces the affine_span
+	// function of the span drawer base class.
+	static void affine_span(
+		int x, 
+		int y, 
+		IRasterizer::FragmentData fd, 
+		const IRasterizer::FragmentData &step, 
+		unsigned n,
+		void *userdata)
 	{
-		SDL_Surface *screen = SDL_GetVideoSurface();
-		return static_cast<unsigned short*>(screen->pixels) + x + y * screen->w;
+		screen_buffer->touch(x, y, n);
+		unsigned short *color = screen_buffer->color_pointer(x, y);
+		texture->sample_bilinear_span(fd.varyings[0], fd.varyings[1], 
+			step.varyings[0], step.varyings[1], n, color, level);
 	}
+#endif
 
-	// this is called by the span drawing function to get the location of the depth buffer
-	static void* depth_pointer(int x, int y, void *userdata)
+	// this is called by the span drawing function to get the framebuffer
+	static Framebuffer& framebuffer(void *userdata)
 	{
-		// We don't use a depth buffer
-		return 0;
+		return *screen_buffer;
 	}
 
-	static Texture *texture;
+	static Texture16 *texture;
+	static int level;
 };
 
-Texture *FragmentShader::texture = 0;
+Texture16 *FragmentShader::texture = 0;
+int FragmentShader::level = 0;
+#ifdef ETC1_TEXTURE
+Texture16::Cache FragmentShader::cache;
+#endif
 
 int main(int ac, char *av[]) {
 	// initialize SDL without error handling an all
@@ -235,16 +261,28 @@ int main(int ac, char *av[]) {
 		{ 1.0f,  1.0f, 1.0f, 0.0f}
 	};
 
-	// load the texture file
-	Texture *texture = new Texture(load_surface_r5g5a1b5("data/texture.png"));
-
-	// make the shaders know which texture to use
-	VertexShader::texture = texture;
+	// load the texture file and create the texture with all mipmap levels
+#ifdef ETC1_TEXTURE
+	Texture16 *texture = load_texture_etc1("data/texture.png");
+#else
+	SDL_Surface *surface = load_surface_16bit("data/texture.png");
+	Texture16 *texture = new Texture16(surface->w, surface->h, 
+		static_cast<const Texture16::pixel_type*>(surface->pixels), surface->pitch / 2);
+	SDL_FreeSurface(surface);
+#endif
+
+	// make the fragment shader know which texture to use
 	FragmentShader::texture = texture;
 
 	// the indices we need for rendering
 	unsigned indices[] = {0, 1, 2, 0, 2, 3};
 
+	// render directly into the screen surface which is 16 bit r5g6b5. we 
+	// don't use a depth buffer.
+	SDL_LockSurface(screen);
+	screen_buffer = new Framebuffer(screen->pixels, screen->w, screen->h, screen->pitch, false);
+	screen_buffer->clear(0, 0);
+
 	// create a rasterizer class that will be used to rasterize primitives
 	RasterizerSubdivAffine r;
 	// create a geometry processor class used to feed vertex data.
@@ -267,6 +305,10 @@ int main(int ac, char *av[]) {
 	// draw the triangle
 	g.draw_triangles(6, indices);
 
+	// fill the rest of the screen with the clear color
+	screen_buffer->resolve();
+	SDL_UnlockSurface(screen);
+
 	// show everything on screen
 	SDL_Flip(SDL_GetVideoSurface());
 
@@ -274,8 +316,9 @@ int main(int ac, char *av[]) {
 	SDL_Event e;
 	while (SDL_WaitEvent(&e) && e.type != SDL_QUIT);
 
-	// free texture memory
+	// free texture memory and the framebuffer
 	delete texture;
+	delete screen_buffer;
 
 	// quit SDL
 	SDL_Quit();
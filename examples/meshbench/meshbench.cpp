@@ -0,0 +1,203 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+// Measures how long it takes to load a mesh and convert it into vertex and
+// index arrays. Does not need SDL.
+//
+// usage: meshbench [file.obj | -grid n] [thread count]
+//
+// With -grid a n*n quad grid (2*n*n triangles) is generated in memory and
+// parsed from there. This makes it easy to test really large meshes.
+
+#include "util/objdata.h"
+#include "util/meshfile.h"
+#include "util/meshopt.h"
+#include "util/meshlet.h"
+#include "util/lod.h"
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/time.h>
+#endif
+
+// wall clock time in milliseconds
+double now_ms()
+{
+#ifdef _WIN32
+	LARGE_INTEGER f, t;
+	QueryPerformanceFrequency(&f);
+	QueryPerformanceCounter(&t);
+	return t.QuadPart * 1000.0 / f.QuadPart;
+#else
+	timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+#endif
+}
+
+// creates the .obj file contents for a n*n grid of quads
+std::string make_grid(int n)
+{
+	std::ostringstream oss;
+	for (int y = 0; y <= n; ++y)
+		for (int x = 0; x <= n; ++x)
+			oss << "v " << x * 0.01f << " " << y * 0.01f << " " << ((x ^ y) & 7) * 0.001f << "\n";
+	for (int y = 0; y <= n; ++y)
+		for (int x = 0; x <= n; ++x)
+			oss << "vt " << x / float(n) << " " << y / float(n) << "\n";
+	oss << "vn 0 0 1\n";
+
+	for (int y = 0; y < n; ++y) {
+		for (int x = 0; x < n; ++x) {
+			int i = y * (n + 1) + x + 1;
+			oss << "f " << i << "/" << i << "/1 " 
+				<< i + 1 << "/" << i + 1 << "/1 " 
+				<< i + n + 2 << "/" << i + n + 2 << "/1 " 
+				<< i + n + 1 << "/" << i + n + 1 << "/1\n";
+		}
+	}
+
+	return oss.str();
+}
+
+int main(int ac, char *av[])
+{
+	const char *filename = "data/cow.obj";
+	int grid = 0;
+	int threads = 4;
+
+	int arg = 1;
+	if (arg < ac && std::strcmp(av[arg], "-grid") == 0 && arg + 1 < ac) {
+		grid = std::atoi(av[arg + 1]);
+		arg += 2;
+	} else if (arg < ac) {
+		filename = av[arg++];
+	}
+	if (arg < ac) threads = std::atoi(av[arg]);
+
+	std::string grid_data;
+	if (grid) grid_data = make_grid(grid);
+
+	// repeat small meshes a few times to get measurable numbers
+	const int runs = grid ? 1 : 20;
+
+	// single threaded first, then with the requested number of threads
+	const int thread_counts[] = {1, threads};
+
+	ObjData mesh;
+	for (int k = 0; k < (threads > 1 ? 2 : 1); ++k) {
+		const int t = thread_counts[k];
+		double t0 = now_ms();
+		for (int i = 0; i < runs; ++i) {
+			mesh = grid ? 
+				ObjData::load_from_memory(grid_data.data(), grid_data.size(), t) :
+				ObjData::load_from_file(filename, t);
+		}
+		double t1 = now_ms();
+		std::cout << "load (" << t << " threads): " << (t1 - t0) / runs << " ms" << std::endl;
+	}
+
+	// the measurements below need at least one triangle
+	if (mesh.faces.empty()) {
+		std::cout << "no faces in " << (grid ? "the grid" : filename) << std::endl;
+		return 1;
+	}
+
+	std::cout << "positions: " << mesh.vertices.size() - 1 << std::endl;
+	std::cout << "faces: " << mesh.faces.size() << std::endl;
+
+	std::vector<ObjData::VertexArrayData> vdata;
+	std::vector<unsigned> idata;
+
+	const ObjData::DedupMethod methods[] = {ObjData::DEDUP_MAP, ObjData::DEDUP_HASH};
+	const char *names[] = {"map", "hash"};
+
+	for (int m = 0; m < 2; ++m) {
+		double t0 = now_ms();
+		for (int i = 0; i < runs; ++i)
+			mesh.to_vertex_array(vdata, idata, methods[m]);
+		double t1 = now_ms();
+		std::cout << "to_vertex_array (" << names[m] << "): " << (t1 - t0) / runs << " ms" << std::endl;
+	}
+
+	std::cout << "vertices: " << vdata.size() << std::endl;
+	std::cout << "triangles: " << idata.size() / 3 << std::endl;
+
+	// reorder for the post-transform cache of the vertex processor
+	std::cout << "acmr before: " << meshopt::acmr(&idata[0], idata.size()) << std::endl;
+	{
+		double t0 = now_ms();
+		std::vector<unsigned> remap;
+		meshopt::optimize_vertex_cache(&idata[0], idata.size(), vdata.size());
+		meshopt::optimize_vertex_fetch(remap, &idata[0], idata.size(), vdata.size());
+		meshopt::remap_vertices(vdata, remap);
+		double t1 = now_ms();
+		std::cout << "optimize: " << t1 - t0 << " ms" << std::endl;
+	}
+	std::cout << "acmr after: " << meshopt::acmr(&idata[0], idata.size()) << std::endl;
+
+	// split into meshlets for culling
+	{
+		std::vector<meshlet::Meshlet> meshlets;
+		double t0 = now_ms();
+		meshlet::build(meshlets, &idata[0], idata.size(), &vdata[0].vertex, vdata.size(),
+			sizeof(ObjData::VertexArrayData));
+		double t1 = now_ms();
+
+		size_t vertices = 0;
+		for (size_t i = 0; i < meshlets.size(); ++i)
+			vertices += meshlets[i].vertex_count;
+		std::cout << "meshlets: " << meshlets.size() << " (" << t1 - t0 << " ms, "
+			<< float(vertices) / meshlets.size() << " vertices and "
+			<< float(idata.size() / 3) / meshlets.size() << " triangles per meshlet)" << std::endl;
+		std::cout << "acmr meshlets: " << meshopt::acmr(&idata[0], idata.size()) << std::endl;
+	}
+
+	// level of detail chain
+	{
+		std::vector<lod::Level> levels;
+		std::vector<unsigned> lod_indices;
+		double t0 = now_ms();
+		lod::build_chain(levels, lod_indices, &idata[0], idata.size(), &vdata[0].vertex, vdata.size(),
+			sizeof(ObjData::VertexArrayData));
+		double t1 = now_ms();
+
+		std::cout << "lod chain: " << t1 - t0 << " ms" << std::endl;
+		for (size_t i = 0; i < levels.size(); ++i)
+			std::cout << "  level " << i << ": " << levels[i].index_count / 3 << " triangles, error " 
+				<< levels[i].error << std::endl;
+	}
+
+	// compare with opening the same mesh as binary mesh file
+	const char *binary_filename = "meshbench.swrm";
+	{
+		MeshFile file;
+		file.create(vdata, idata, MeshFile::FORMAT_FIXED16);
+		if (!file.save(binary_filename)) {
+			std::cout << "could not write " << binary_filename << std::endl;
+			return 1;
+		}
+	}
+
+	double t0 = now_ms();
+	unsigned checksum = 0;
+	for (int i = 0; i < runs; ++i) {
+		MeshFile file;
+		file.open(binary_filename);
+		checksum += file.index_count();
+	}
+	double t1 = now_ms();
+	std::cout << "binary mesh open: " << (t1 - t0) / runs << " ms (" << checksum / runs << " indices)" << std::endl;
+
+	std::remove(binary_filename);
+	return 0;
+}
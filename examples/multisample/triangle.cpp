@@ -37,6 +37,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "renderer/geometry_processor.h"
 #include "renderer/rasterizer_subdivaffine.h"
 #include "renderer/span.h"
+#include "renderer/pixel_format.h"
+#include "renderer/framebuffer.h"
 
 #include "util/vector_math.h"
 
@@ -95,6 +97,9 @@ struct VertexShader {
 
 vmath::mat4<float> VertexShader::transformation = vmath::identity4<float>();
 
+// The pixels of the screen surface which is 16 bit r5g6b5.
+Plane<unsigned short> screen_pixels;
+
 struct FragmentShaderMultisample : public SpanDrawerMultisampling<FragmentShaderMultisample, 2> {
 	// varying_count = 3 tells the rasterizer that it only needs to interpolate
 	// three varying values (the r, g and b in this context).
@@ -112,9 +117,7 @@ struct FragmentShaderMultisample : public SpanDrawerMultisampling<FragmentShader
 			fprintf(stderr, "userdata pointer failure\n");
 
 		// get the location of the pixel
-		SDL_Surface *screen = SDL_GetVideoSurface();
-		unsigned short *color_buffer = static_cast<unsigned short*>(screen->pixels) + x * 2
-				+ y * 2 * screen->w;
+		unsigned short *color_buffer = screen_pixels.pointer(x * 2, y * 2);
 
 		// Convert from 16.16 color format to [0,255]
 		// Here the colors are clamped to the range[0,255]. If this is not done
@@ -122,13 +125,13 @@ struct FragmentShaderMultisample : public SpanDrawerMultisampling<FragmentShader
 		int r = std::min(std::max(fd.varyings[0] >> 16, 0), 255);
 		int g = std::min(std::max(fd.varyings[1] >> 16, 0), 255);
 		int b = std::min(std::max(fd.varyings[2] >> 16, 0), 255);
-		Uint32 color = SDL_MapRGB(screen->format, r, g, b);
+		unsigned short color = RGB565::from_rgb(r, g, b);
 
 		if (coverage_mask & 0x01)
 			color_buffer[0] = color;
 		if (coverage_mask & 0x02)
 			color_buffer[1] = color;
-		color_buffer += screen->pitch / 2;
+		color_buffer = screen_pixels.row(y * 2 + 1) + x * 2;
 		if (coverage_mask & 0x04)
 			color_buffer[0] = color;
 		if (coverage_mask & 0x08)
@@ -140,6 +143,7 @@ int main(int ac, char *av[]) {
 	// Intialize SDL without error handling an all
 	SDL_Init(SDL_INIT_VIDEO);
 	SDL_Surface *screen = SDL_SetVideoMode(640, 480, 16, 0);
+	screen_pixels.attach(screen->pixels, screen->w, screen->h, screen->pitch);
 
 	// The three vertices of the triangle and the colors
 	Vertex vertices[] = {
@@ -38,6 +38,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "renderer/rasterizer_parallel.h"
 #include "renderer/rasterizer_subdivaffine.h"
 #include "renderer/span.h"
+#include "renderer/framebuffer.h"
 
 // other includes
 #include "util/vector_math.h"
@@ -126,11 +127,8 @@ struct MyVertexShader {
 vec3x MyVertexShader::light_dir_= normalize<fixed16_t>(vec3x(10.0f, 10.0f, 10.f));
 mat4x MyVertexShader::model_view_projection_matrix_;
 
-// global depth buffer we will use.
-SDL_Surface * depth_buffer;
-
-// global drawing surface.
-SDL_Surface * shadow;
+// global color and depth buffer we will render to.
+Framebuffer *screen_buffer;
 
 #define USE_GENERIC_SPAN_DRAWER 0
 
@@ -138,7 +136,7 @@ SDL_Surface * shadow;
 #if USE_GENERIC_SPAN_DRAWER
 struct MyFragmentShader : public GenericSpanDrawer<MyFragmentShader> {
 #else
-struct MyFragmentShader : public SpanDrawer16BitColorAndDepth<MyFragmentShader> {
+struct MyFragmentShader : public SpanDrawerFramebuffer<MyFragmentShader> {
 #endif
 	// varying_count = 1 tells the rasterizer that it only needs to interpolate
 	// one varying value which will be the lighting value computed per vertex.
@@ -166,9 +164,11 @@ struct MyFragmentShader : public SpanDrawer16BitColorAndDepth<MyFragmentShader>
 	// this one is to be used with the GenericSpanDrawer
 	static void single_fragment(int x, int y, const IRasterizer::FragmentData &fd, void *userdata)
 	{
+		// the framebuffer is cleared lazily, so make sure the pixel is valid.
+		screen_buffer->touch(x, y, 1);
+
 		// get the depth buffer pixel from x, y parameters.
-		unsigned short *db = static_cast<unsigned short*>(depth_buffer->pixels) +
-			x + y * depth_buffer->w;
+		unsigned short *db = screen_buffer->depth_pointer(x, y);
 
 		// do the depth test (note: we have a 16bit depth buffer, therefore the shift).
 		unsigned short depth = fd.z >> 16;
@@ -176,8 +176,7 @@ struct MyFragmentShader : public SpanDrawer16BitColorAndDepth<MyFragmentShader>
 		*db = depth;
 
 		// get the color buffer pixel.
-		unsigned short *color_buffer = static_cast<unsigned short*>(shadow->pixels) + 
-			x + y * shadow->w;
+		unsigned short *color_buffer = screen_buffer->color_pointer(x, y);
 
 		// make sure the interpolated value lies in the correct range.
 		int s = std::min(std::max(fd.varyings[0] >> 16, 0), 31);
@@ -203,16 +202,10 @@ struct MyFragmentShader : public SpanDrawer16BitColorAndDepth<MyFragmentShader>
 		color = (s << 11) | (s << 6) | s;
 	}
 
-	// this is called by the span drawing function to get the location of the color buffer
-	static void* color_pointer(int x, int y, void *userdata)
+	// this is called by the span drawing function to get the framebuffer to draw to.
+	static Framebuffer& framebuffer(void *userdata)
 	{
-		return static_cast<unsigned short*>(shadow->pixels) + x + y * shadow->w;
-	}
-
-	// this is called by the span drawing function to get the location of the depth buffer
-	static void* depth_pointer(int x, int y, void *userdata)
-	{
-		return static_cast<unsigned short*>(depth_buffer->pixels) + x + y * depth_buffer->w;
+		return *screen_buffer;
 	}
 #endif
 };
@@ -249,15 +242,11 @@ int main(int /*ac*/, char * /*av*/[])
 	// used to access GP2X buttons.
 	SDL_JoystickOpen(0);
 #endif
-	// we will render into the shadow surface and blit to the main screen at the end.
-	// doing it this way one can circumvent double buffering on the GP2X 
-	// and thus render faster.
-	shadow = SDL_DisplayFormat(screen);
-
-	// create a 16bit depth buffer. making it a hw surface will allow us 
-	// to do fast clears and using the mmuhack on the GP2X also gives us fast 
-	// access to the memory.
-	depth_buffer = SDL_CreateRGBSurface(SDL_HWSURFACE, width, height, 16, 0, 0, 0, 0);
+	// we will render into the framebuffer and copy it to the screen at the end.
+	// the framebuffer stores 64x64 tiles one after the other. the parallel 
+	// rasterizer aligns its regions to these tiles, so every thread only 
+	// touches its own memory.
+	screen_buffer = new Framebuffer(width, height, true, FRAMEBUFFER_TILED);
 
 #ifdef GP2X
 	gp2x_init();
@@ -316,11 +305,9 @@ int main(int /*ac*/, char * /*av*/[])
 			}
 		}
 
-		// clear the screen and the depth buffer.
-		#ifndef FPS_TEST
-			SDL_FillRect(shadow, 0, 0);
-			SDL_FillRect(depth_buffer, 0, 0xffffffff);
-		#endif
+		// clear the color and the depth buffer. this only marks the tiles of
+		// the framebuffer as cleared and is very cheap.
+		screen_buffer->clear(0, 0xffff);
 
 		// create a transformation depending on the time to rotate around the object.
 		fixed16_t time(SDL_GetTicks() / 1000.0f);
@@ -330,28 +317,21 @@ int main(int /*ac*/, char * /*av*/[])
 			perspective_matrix<fixed16_t>(60.0f, 4.0f/3.0f, 0.5f, 100.0f) *
 			lookat_matrix(eye, vec3x(0.0f), vec3x(0.0f, 1.0f, 0.0f));
 
-		// lock the surfaces as we want to directly write to them.
-		const int r1 = SDL_LockSurface(depth_buffer);
-		const int r2 = SDL_LockSurface(shadow);
-		
-		// draw the mesh by sending the vertex data to the pipeline (only when locking worked).
-		if (!r1 && !r2)	{
-			g.draw_triangles(idata.size(), &idata[0]);
-		#ifdef GP2X
-			flush_uppermem_cache(
-				shadow->pixels, 
-				static_cast<char*>(shadow->pixels) + shadow->pitch * shadow->h,
-				0);
-		#endif
-		}
-
-		// unlock them again.
-		if (!r2) SDL_UnlockSurface(shadow);
-		if (!r2) SDL_UnlockSurface(depth_buffer);
+		// draw the mesh by sending the vertex data to the pipeline.
+		g.draw_triangles(idata.size(), &idata[0]);
 
-		// blit shadow surface to screen and show the screen.
+		// copy the framebuffer to the screen and show the screen.
 		#ifndef FPS_TEST
-			SDL_BlitSurface(shadow, 0, screen, 0);
+			if (!SDL_LockSurface(screen)) {
+				screen_buffer->present(screen->pixels, screen->pitch);
+			#ifdef GP2X
+				flush_uppermem_cache(
+					screen->pixels, 
+					static_cast<char*>(screen->pixels) + screen->pitch * screen->h,
+					0);
+			#endif
+				SDL_UnlockSurface(screen);
+			}
 			SDL_Flip(screen);
 		#endif
 
@@ -369,9 +349,8 @@ int main(int /*ac*/, char * /*av*/[])
 		}
 	}
 end:
-	// free the created surfaces.
-	SDL_FreeSurface(shadow);
-	SDL_FreeSurface(depth_buffer);
+	// free the framebuffer.
+	delete screen_buffer;
 
 	// quit SDL.
 	SDL_Quit();
@@ -7,6 +7,8 @@
 #include "renderer/geometry_processor.h"
 #include "renderer/rasterizer_subdivaffine.h"
 #include "renderer/span.h"
+#include "renderer/pixel_format.h"
+#include "renderer/framebuffer_sdl.h"
 
 #define _TIMESPEC_DEFINED // prevent compiler error on VS2015
 #include <pthread.h>
@@ -18,7 +20,7 @@ struct Userdata {
 	int g;
 	int b;
 
-	SDL_Surface *buffer;
+	Framebuffer *buffer;
 };
 
 struct Vertex {
@@ -47,7 +49,7 @@ struct VertexShader {
 
 #define USE_GENERIC_SPAN_DRAWER 1
 
-struct FragmentShader : public SpanDrawer16BitColorAndDepth<FragmentShader> {
+struct FragmentShader : public SpanDrawerFramebuffer<FragmentShader> {
 	static const unsigned varying_count = 3;
 	static const bool interpolate_z = false;
 
@@ -76,20 +78,13 @@ struct FragmentShader : public SpanDrawer16BitColorAndDepth<FragmentShader> {
 		g = (g + ud->g) >> 1;
 		b = (b + ud->b) >> 1;
 
-		SDL_Surface *buffer = ud->buffer;
-		color = SDL_MapRGB(buffer->format, r, g, b);
+		color = RGB565::from_rgb(r, g, b);
 	}
 
-	static void* color_pointer(int x, int y, void *userdata)
+	static Framebuffer& framebuffer(void *userdata)
 	{
 		Userdata *ud = (Userdata*) userdata;
-		SDL_Surface *buffer = ud->buffer;
-		return static_cast<unsigned short*>(buffer->pixels) + x + y * buffer->w;
-	}
-
-	static void* depth_pointer(int x, int y, void *userdata)
-	{
-		return 0;
+		return *ud->buffer;
 	}
 };
 
@@ -108,10 +103,10 @@ void* thread_function(void *arg)
 	RasterizerSubdivAffine r;
 	GeometryProcessor g(&r);
 	r.userdata(userdata);
-	r.clip_rect(0, 0, userdata->buffer->w, userdata->buffer->h);
+	r.clip_rect(0, 0, userdata->buffer->width(), userdata->buffer->height());
 	r.fragment_shader<FragmentShader>();
 
-	g.viewport(0, 0, userdata->buffer->w, userdata->buffer->h);
+	g.viewport(0, 0, userdata->buffer->width(), userdata->buffer->height());
 	g.cull_mode(GeometryProcessor::CULL_CW);
 	g.vertex_attrib_pointer(0, sizeof(Vertex), vertices);
 	g.vertex_shader<VertexShader>();
@@ -138,8 +133,10 @@ int main(int ac, char *av[])
 	userdata2.g = 255;
 	userdata2.b = 0;
 
-	userdata1.buffer = SDL_DisplayFormat(screen);
-	userdata2.buffer = SDL_DisplayFormat(screen);
+	// The framebuffers don't depend on SDL, so the threads render without 
+	// touching any surface.
+	userdata1.buffer = new Framebuffer(screen->w, screen->h, false);
+	userdata2.buffer = new Framebuffer(screen->w, screen->h, false);
 
 	// Render separate frames using two different threads
 	pthread_t thread1;
@@ -163,8 +160,18 @@ int main(int ac, char *av[])
 	right_rect.w = 320;
 	right_rect.h = 480;
 
-	SDL_BlitSurface(userdata1.buffer, &left_rect, screen, &left_rect);
-	SDL_BlitSurface(userdata2.buffer, &right_rect, screen, &right_rect);
+	SDL_Surface *surface1 = SDL_DisplayFormat(screen);
+	SDL_Surface *surface2 = SDL_DisplayFormat(screen);
+	present(*userdata1.buffer, surface1);
+	present(*userdata2.buffer, surface2);
+
+	SDL_BlitSurface(surface1, &left_rect, screen, &left_rect);
+	SDL_BlitSurface(surface2, &right_rect, screen, &right_rect);
+
+	SDL_FreeSurface(surface1);
+	SDL_FreeSurface(surface2);
+	delete userdata1.buffer;
+	delete userdata2.buffer;
 
 	SDL_Flip(SDL_GetVideoSurface());
 
@@ -0,0 +1,323 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef BILINEAR_SPAN_H_
+#define BILINEAR_SPAN_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "pixel_format.h"
+
+#include <stdint.h>
+
+// Define SWR_NO_SIMD to always use the scalar code.
+#if !defined(SWR_NO_SIMD)
+#	if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#		define SWR_SSE2 1
+#		include <emmintrin.h>
+#	elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#		define SWR_NEON 1
+#		include <arm_neon.h>
+#	endif
+#endif
+
+namespace swr {
+	namespace detail {
+
+		// The texels and filter fractions of up to BATCH_SIZE pixels. Texture
+		// gathers them (this depends on the memory layout) and the filter
+		// below does the arithmetic for all of them at once.
+		template <typename PixelType>
+		struct BilinearBatch {
+			static const unsigned BATCH_SIZE = 8;
+
+			// a and b are the upper, c and d the lower texels
+			PixelType a[BATCH_SIZE], b[BATCH_SIZE], c[BATCH_SIZE], d[BATCH_SIZE];
+			// 8 bit fractions
+			uint16_t fx[BATCH_SIZE], fy[BATCH_SIZE];
+
+			BilinearBatch()
+			{
+				for (unsigned i = 0; i < BATCH_SIZE; ++i) {
+					a[i] = b[i] = c[i] = d[i] = 0;
+					fx[i] = fy[i] = 0;
+				}
+			}
+		};
+
+		// Filters count pixels of a batch. Works for all pixel formats.
+		template <typename PixelFormat>
+		struct BilinearSpan {
+			typedef typename PixelFormat::pixel_type pixel_type;
+
+			static void filter(const BilinearBatch<pixel_type> &batch, unsigned count, pixel_type *out)
+			{
+				for (unsigned i = 0; i < count; ++i)
+					out[i] = PixelFormat::bilinear(batch.a[i], batch.b[i], batch.c[i], batch.d[i],
+						batch.fx[i], batch.fy[i]);
+			}
+		};
+
+		// The SIMD versions use weights for the four texels which always sum
+		// up to 256, so the weighted sums of 8 bit channels still fit into 16
+		// bits. Only w11 is rounded, the others follow from it exactly, so no
+		// weight is off by more than 1/512 and the sums are rounded once.
+		// Against exact bilinear filtering the results are at most 1.5 LSB
+		// off, less than the scalar PixelFormat::bilinear functions.
+		//
+		// w11 = fx * fy / 256 (rounded)
+		// w01 = fx - w11
+		// w10 = fy - w11
+		// w00 = 256 - fx - fy + w11
+
+	#if defined(SWR_SSE2)
+
+		inline void bilinear_weights_sse2(const uint16_t *fx8, const uint16_t *fy8,
+			__m128i &w00, __m128i &w01, __m128i &w10, __m128i &w11)
+		{
+			const __m128i c128 = _mm_set1_epi16(128);
+			const __m128i c256 = _mm_set1_epi16(256);
+			const __m128i fx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(fx8));
+			const __m128i fy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(fy8));
+
+			// fx * fy + 128 is at most 65153 and fits into unsigned 16 bits
+			w11 = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(fx, fy), c128), 8);
+			w01 = _mm_sub_epi16(fx, w11);
+			w10 = _mm_sub_epi16(fy, w11);
+			w00 = _mm_add_epi16(_mm_sub_epi16(_mm_sub_epi16(c256, fx), fy), w11);
+		}
+
+		template <>
+		struct BilinearSpan<RGB565> {
+			// filters one channel of 8 pixels. the channel values are at most
+			// 6 bits, so the weighted sum fits into 16 bits.
+			static __m128i channel(__m128i a, __m128i b, __m128i c, __m128i d,
+				__m128i w00, __m128i w01, __m128i w10, __m128i w11)
+			{
+				__m128i r = _mm_mullo_epi16(a, w00);
+				r = _mm_add_epi16(r, _mm_mullo_epi16(b, w01));
+				r = _mm_add_epi16(r, _mm_mullo_epi16(c, w10));
+				r = _mm_add_epi16(r, _mm_mullo_epi16(d, w11));
+				return _mm_srli_epi16(_mm_add_epi16(r, _mm_set1_epi16(128)), 8);
+			}
+
+			static void filter(const BilinearBatch<uint16_t> &batch, unsigned count, uint16_t *out)
+			{
+				__m128i w00, w01, w10, w11;
+				bilinear_weights_sse2(batch.fx, batch.fy, w00, w01, w10, w11);
+
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(batch.a));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(batch.b));
+				const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(batch.c));
+				const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(batch.d));
+
+				const __m128i mask5 = _mm_set1_epi16(0x1f);
+				const __m128i mask6 = _mm_set1_epi16(0x3f);
+
+				const __m128i r = channel(
+					_mm_srli_epi16(a, 11), _mm_srli_epi16(b, 11),
+					_mm_srli_epi16(c, 11), _mm_srli_epi16(d, 11),
+					w00, w01, w10, w11);
+				const __m128i g = channel(
+					_mm_and_si128(_mm_srli_epi16(a, 5), mask6), _mm_and_si128(_mm_srli_epi16(b, 5), mask6),
+					_mm_and_si128(_mm_srli_epi16(c, 5), mask6), _mm_and_si128(_mm_srli_epi16(d, 5), mask6),
+					w00, w01, w10, w11);
+				const __m128i bl = channel(
+					_mm_and_si128(a, mask5), _mm_and_si128(b, mask5),
+					_mm_and_si128(c, mask5), _mm_and_si128(d, mask5),
+					w00, w01, w10, w11);
+
+				const __m128i result = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), bl);
+
+				if (count == BilinearBatch<uint16_t>::BATCH_SIZE) {
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out), result);
+				} else {
+					uint16_t tmp[BilinearBatch<uint16_t>::BATCH_SIZE];
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(tmp), result);
+					for (unsigned i = 0; i < count; ++i)
+						out[i] = tmp[i];
+				}
+			}
+		};
+
+		template <>
+		struct BilinearSpan<RGBA8888> {
+			// filters the four channels of one pixel with madd. ab and cd hold
+			// the channels of the upper and lower texels interleaved as 16 bit
+			// values, wab and wcd the matching weight pairs.
+			static __m128i pixel(__m128i ab, __m128i cd, uint16_t w00, uint16_t w01, uint16_t w10, uint16_t w11)
+			{
+				const __m128i wab = _mm_set1_epi32(w00 | (w01 << 16));
+				const __m128i wcd = _mm_set1_epi32(w10 | (w11 << 16));
+				const __m128i sum = _mm_add_epi32(_mm_madd_epi16(ab, wab), _mm_madd_epi16(cd, wcd));
+				return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8);
+			}
+
+			static void filter4(const BilinearBatch<uint32_t> &batch, unsigned offset,
+				const uint16_t *w00, const uint16_t *w01, const uint16_t *w10, const uint16_t *w11,
+				uint32_t *out)
+			{
+				const __m128i zero = _mm_setzero_si128();
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(batch.a + offset));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(batch.b + offset));
+				const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(batch.c + offset));
+				const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(batch.d + offset));
+
+				// channels as 16 bit values, two pixels per register
+				const __m128i a_lo = _mm_unpacklo_epi8(a, zero), a_hi = _mm_unpackhi_epi8(a, zero);
+				const __m128i b_lo = _mm_unpacklo_epi8(b, zero), b_hi = _mm_unpackhi_epi8(b, zero);
+				const __m128i c_lo = _mm_unpacklo_epi8(c, zero), c_hi = _mm_unpackhi_epi8(c, zero);
+				const __m128i d_lo = _mm_unpacklo_epi8(d, zero), d_hi = _mm_unpackhi_epi8(d, zero);
+
+				const unsigned i = offset;
+				const __m128i p0 = pixel(_mm_unpacklo_epi16(a_lo, b_lo), _mm_unpacklo_epi16(c_lo, d_lo), w00[i + 0], w01[i + 0], w10[i + 0], w11[i + 0]);
+				const __m128i p1 = pixel(_mm_unpackhi_epi16(a_lo, b_lo), _mm_unpackhi_epi16(c_lo, d_lo), w00[i + 1], w01[i + 1], w10[i + 1], w11[i + 1]);
+				const __m128i p2 = pixel(_mm_unpacklo_epi16(a_hi, b_hi), _mm_unpacklo_epi16(c_hi, d_hi), w00[i + 2], w01[i + 2], w10[i + 2], w11[i + 2]);
+				const __m128i p3 = pixel(_mm_unpackhi_epi16(a_hi, b_hi), _mm_unpackhi_epi16(c_hi, d_hi), w00[i + 3], w01[i + 3], w10[i + 3], w11[i + 3]);
+
+				const __m128i result = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out), result);
+			}
+
+			static void filter(const BilinearBatch<uint32_t> &batch, unsigned count, uint32_t *out)
+			{
+				uint16_t w[4][BilinearBatch<uint32_t>::BATCH_SIZE];
+				{
+					__m128i w00, w01, w10, w11;
+					bilinear_weights_sse2(batch.fx, batch.fy, w00, w01, w10, w11);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(w[0]), w00);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(w[1]), w01);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(w[2]), w10);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(w[3]), w11);
+				}
+
+				if (count == BilinearBatch<uint32_t>::BATCH_SIZE) {
+					filter4(batch, 0, w[0], w[1], w[2], w[3], out);
+					filter4(batch, 4, w[0], w[1], w[2], w[3], out + 4);
+				} else {
+					uint32_t tmp[BilinearBatch<uint32_t>::BATCH_SIZE];
+					filter4(batch, 0, w[0], w[1], w[2], w[3], tmp);
+					if (count > 4)
+						filter4(batch, 4, w[0], w[1], w[2], w[3], tmp + 4);
+					for (unsigned i = 0; i < count; ++i)
+						out[i] = tmp[i];
+				}
+			}
+		};
+
+	#elif defined(SWR_NEON)
+
+		inline void bilinear_weights_neon(const uint16_t *fx8, const uint16_t *fy8,
+			uint16x8_t &w00, uint16x8_t &w01, uint16x8_t &w10, uint16x8_t &w11)
+		{
+			const uint16x8_t c256 = vdupq_n_u16(256);
+			const uint16x8_t fx = vld1q_u16(fx8);
+			const uint16x8_t fy = vld1q_u16(fy8);
+
+			w11 = vrshrq_n_u16(vmulq_u16(fx, fy), 8);
+			w01 = vsubq_u16(fx, w11);
+			w10 = vsubq_u16(fy, w11);
+			w00 = vaddq_u16(vsubq_u16(vsubq_u16(c256, fx), fy), w11);
+		}
+
+		template <>
+		struct BilinearSpan<RGB565> {
+			static uint16x8_t channel(uint16x8_t a, uint16x8_t b, uint16x8_t c, uint16x8_t d,
+				uint16x8_t w00, uint16x8_t w01, uint16x8_t w10, uint16x8_t w11)
+			{
+				uint16x8_t r = vmulq_u16(a, w00);
+				r = vmlaq_u16(r, b, w01);
+				r = vmlaq_u16(r, c, w10);
+				r = vmlaq_u16(r, d, w11);
+				return vrshrq_n_u16(r, 8);
+			}
+
+			static void filter(const BilinearBatch<uint16_t> &batch, unsigned count, uint16_t *out)
+			{
+				uint16x8_t w00, w01, w10, w11;
+				bilinear_weights_neon(batch.fx, batch.fy, w00, w01, w10, w11);
+
+				const uint16x8_t a = vld1q_u16(batch.a);
+				const uint16x8_t b = vld1q_u16(batch.b);
+				const uint16x8_t c = vld1q_u16(batch.c);
+				const uint16x8_t d = vld1q_u16(batch.d);
+
+				const uint16x8_t mask5 = vdupq_n_u16(0x1f);
+				const uint16x8_t mask6 = vdupq_n_u16(0x3f);
+
+				const uint16x8_t r = channel(
+					vshrq_n_u16(a, 11), vshrq_n_u16(b, 11),
+					vshrq_n_u16(c, 11), vshrq_n_u16(d, 11),
+					w00, w01, w10, w11);
+				const uint16x8_t g = channel(
+					vandq_u16(vshrq_n_u16(a, 5), mask6), vandq_u16(vshrq_n_u16(b, 5), mask6),
+					vandq_u16(vshrq_n_u16(c, 5), mask6), vandq_u16(vshrq_n_u16(d, 5), mask6),
+					w00, w01, w10, w11);
+				const uint16x8_t bl = channel(
+					vandq_u16(a, mask5), vandq_u16(b, mask5),
+					vandq_u16(c, mask5), vandq_u16(d, mask5),
+					w00, w01, w10, w11);
+
+				const uint16x8_t result = vorrq_u16(vorrq_u16(vshlq_n_u16(r, 11), vshlq_n_u16(g, 5)), bl);
+
+				if (count == BilinearBatch<uint16_t>::BATCH_SIZE) {
+					vst1q_u16(out, result);
+				} else {
+					uint16_t tmp[BilinearBatch<uint16_t>::BATCH_SIZE];
+					vst1q_u16(tmp, result);
+					for (unsigned i = 0; i < count; ++i)
+						out[i] = tmp[i];
+				}
+			}
+		};
+
+		template <>
+		struct BilinearSpan<RGBA8888> {
+			// filters two pixels. the weights are repeated for each channel.
+			// they can be 256 and need 16 bits, the sums still fit.
+			static uint8x8_t filter2(const BilinearBatch<uint32_t> &batch, unsigned i,
+				const uint16_t *w00, const uint16_t *w01, const uint16_t *w10, const uint16_t *w11)
+			{
+				const uint16x8_t a = vmovl_u8(vreinterpret_u8_u32(vld1_u32(batch.a + i)));
+				const uint16x8_t b = vmovl_u8(vreinterpret_u8_u32(vld1_u32(batch.b + i)));
+				const uint16x8_t c = vmovl_u8(vreinterpret_u8_u32(vld1_u32(batch.c + i)));
+				const uint16x8_t d = vmovl_u8(vreinterpret_u8_u32(vld1_u32(batch.d + i)));
+
+				const uint16x8_t wa = vcombine_u16(vdup_n_u16(w00[i]), vdup_n_u16(w00[i + 1]));
+				const uint16x8_t wb = vcombine_u16(vdup_n_u16(w01[i]), vdup_n_u16(w01[i + 1]));
+				const uint16x8_t wc = vcombine_u16(vdup_n_u16(w10[i]), vdup_n_u16(w10[i + 1]));
+				const uint16x8_t wd = vcombine_u16(vdup_n_u16(w11[i]), vdup_n_u16(w11[i + 1]));
+
+				uint16x8_t r = vmulq_u16(a, wa);
+				r = vmlaq_u16(r, b, wb);
+				r = vmlaq_u16(r, c, wc);
+				r = vmlaq_u16(r, d, wd);
+				return vrshrn_n_u16(r, 8);
+			}
+
+			static void filter(const BilinearBatch<uint32_t> &batch, unsigned count, uint32_t *out)
+			{
+				uint16_t w[4][BilinearBatch<uint32_t>::BATCH_SIZE];
+				{
+					uint16x8_t w00, w01, w10, w11;
+					bilinear_weights_neon(batch.fx, batch.fy, w00, w01, w10, w11);
+					vst1q_u16(w[0], w00);
+					vst1q_u16(w[1], w01);
+					vst1q_u16(w[2], w10);
+					vst1q_u16(w[3], w11);
+				}
+
+				uint32_t tmp[BilinearBatch<uint32_t>::BATCH_SIZE];
+				for (unsigned i = 0; i < count; i += 2)
+					vst1_u32(tmp + i, vreinterpret_u32_u8(filter2(batch, i, w[0], w[1], w[2], w[3])));
+				for (unsigned i = 0; i < count; ++i)
+					out[i] = tmp[i];
+			}
+		};
+
+	#endif
+	}
+}
+
+#endif
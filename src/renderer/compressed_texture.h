@@ -0,0 +1,276 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef COMPRESSED_TEXTURE_H_
+#define COMPRESSED_TEXTURE_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "texture.h"
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+namespace swr {
+
+	// ETC1 block compression: 4x4 texels in 8 bytes (4 bits per texel). The
+	// block is split into two 2x4 or 4x2 halves, each with a base color and
+	// one of eight modifier tables. Every texel picks one of the four
+	// modifiers of its table which is added to all channels of the base.
+	struct ETC1 {
+		static const unsigned BLOCK_SIZE = 8;
+
+		// the modifier tables; the other two modifiers are the negated ones
+		static int modifier(unsigned table, unsigned index)
+		{
+			static const int tables[8][2] = {
+				{2, 8}, {5, 17}, {9, 29}, {13, 42},
+				{18, 60}, {24, 80}, {33, 106}, {47, 183}
+			};
+			// index 0 and 1 are positive, 2 and 3 negative
+			const int m = tables[table][index & 1];
+			return index & 2 ? -m : m;
+		}
+
+		static int clamp255(int v)
+		{ return v < 0 ? 0 : (v > 255 ? 255 : v); }
+
+		// Decodes a block to 16 texels in row-major order.
+		template <typename PixelFormat>
+		static void decode_block(const uint8_t *block, typename PixelFormat::pixel_type *out)
+		{
+			const uint32_t hi = uint32_t(block[0]) << 24 | uint32_t(block[1]) << 16 | uint32_t(block[2]) << 8 | block[3];
+			const uint32_t lo = uint32_t(block[4]) << 24 | uint32_t(block[5]) << 16 | uint32_t(block[6]) << 8 | block[7];
+
+			const bool flip = (hi & 1) != 0;
+			const bool diff = (hi & 2) != 0;
+			const unsigned table[2] = {(hi >> 5) & 7, (hi >> 2) & 7};
+
+			int base[2][3];
+			for (int c = 0; c < 3; ++c) {
+				const int shift = 27 - c * 8;
+				if (diff) {
+					// 5 bit base and 3 bit signed difference for the second half
+					const int b1 = (hi >> shift) & 0x1f;
+					int d = (hi >> (shift - 3)) & 7;
+					if (d >= 4) d -= 8;
+					const int b2 = (b1 + d) & 0x1f;
+					base[0][c] = b1 << 3 | b1 >> 2;
+					base[1][c] = b2 << 3 | b2 >> 2;
+				} else {
+					// two 4 bit colors
+					const int b1 = (hi >> (shift + 1)) & 0xf;
+					const int b2 = (hi >> (shift - 3)) & 0xf;
+					base[0][c] = b1 * 17;
+					base[1][c] = b2 * 17;
+				}
+			}
+
+			for (unsigned x = 0; x < 4; ++x) {
+				for (unsigned y = 0; y < 4; ++y) {
+					// the texel indices are stored column by column
+					const unsigned i = x * 4 + y;
+					const unsigned index = ((lo >> (i + 16)) & 1) << 1 | ((lo >> i) & 1);
+					const unsigned half = flip ? (y >= 2) : (x >= 2);
+					const int m = modifier(table[half], index);
+					out[y * 4 + x] = PixelFormat::from_rgb(
+						clamp255(base[half][0] + m),
+						clamp255(base[half][1] + m),
+						clamp255(base[half][2] + m));
+				}
+			}
+		}
+	};
+
+	// A cache of decoded blocks. Decoding a block for every texel access
+	// would be far too slow, but the texels of neighboring pixels usually
+	// come from the same few blocks. The cache is direct mapped on the block
+	// position, so a cached area of 8x8 blocks (32x32 texels) never evicts
+	// itself.
+	//
+	// The cache is not synchronized. When rendering with several threads
+	// keep one per thread and pass it to the sampling functions.
+	template <typename PixelFormat>
+	class TextureBlockCache {
+	public:
+		typedef typename PixelFormat::pixel_type pixel_type;
+
+		static const unsigned SIZE_LOG2 = 3;
+		static const unsigned SIZE = 1 << (2 * SIZE_LOG2);
+
+		TextureBlockCache() : hits_(0), misses_(0)
+		{ invalidate(); }
+
+		// Forget all blocks. Needed when the data of a texture changes.
+		void invalidate()
+		{
+			for (unsigned i = 0; i < SIZE; ++i)
+				entries_[i].block = 0;
+		}
+
+		// Returns the 16 decoded texels of the block at (bx, by). block points
+		// to the compressed data and is used as the tag.
+		const pixel_type *texels(const uint8_t *block, unsigned bx, unsigned by)
+		{
+			const unsigned mask = (1 << SIZE_LOG2) - 1;
+			Entry &e = entries_[(bx & mask) | (by & mask) << SIZE_LOG2];
+			if (e.block != block) {
+				ETC1::decode_block<PixelFormat>(block, e.texels);
+				e.block = block;
+				++misses_;
+			} else {
+				++hits_;
+			}
+			return e.texels;
+		}
+
+		// statistics
+		unsigned hits() const { return hits_; }
+		unsigned misses() const { return misses_; }
+		void reset_statistics() { hits_ = misses_ = 0; }
+
+	private:
+		struct Entry {
+			const uint8_t *block;
+			pixel_type texels[16];
+		};
+
+		Entry entries_[SIZE];
+		unsigned hits_, misses_;
+	};
+
+	// An ETC1 compressed texture which is decoded to PixelFormat while
+	// sampling. Uses 4 bits per texel instead of 16 or 32. The dimensions
+	// must be powers of two, texture coordinates are normalized 16.16 values
+	// like for Texture.
+	template <typename PixelFormat>
+	class CompressedTexture {
+	public:
+		typedef typename PixelFormat::pixel_type pixel_type;
+		typedef TextureBlockCache<PixelFormat> Cache;
+
+		static const int MAX_LEVELS = 16;
+
+		CompressedTexture() : level_count_(0) {}
+
+		// Number of bytes of compressed data for a texture with all levels.
+		static size_t data_size(unsigned width, unsigned height, int level_count)
+		{
+			size_t size = 0;
+			for (int i = 0; i < level_count; ++i) {
+				size += blocks(width) * blocks(height) * ETC1::BLOCK_SIZE;
+				if (width > 1) width >>= 1;
+				if (height > 1) height >>= 1;
+			}
+			return size;
+		}
+
+		// Creates the texture from compressed data. The levels follow each
+		// other, every level consists of rows of blocks. Levels smaller than
+		// 4x4 use one block. The data is copied.
+		void create(unsigned width, unsigned height, int level_count, const uint8_t *data)
+		{
+			assert(width && !(width & (width - 1)));
+			assert(height && !(height & (height - 1)));
+			assert(level_count > 0 && level_count <= MAX_LEVELS);
+
+			size_t offset = 0;
+			level_count_ = level_count;
+			for (int i = 0; i < level_count; ++i) {
+				Level &l = levels_[i];
+				l.width = width;
+				l.height = height;
+				l.width_log2 = detail::log2_floor(width);
+				l.height_log2 = detail::log2_floor(height);
+				l.blocks_per_row = blocks(width);
+				l.offset = offset;
+				offset += blocks(width) * blocks(height) * ETC1::BLOCK_SIZE;
+
+				if (width > 1) width >>= 1;
+				if (height > 1) height >>= 1;
+			}
+
+			data_.assign(data, data + offset);
+		}
+
+		int level_count() const
+		{ return level_count_; }
+
+		unsigned width(int level = 0) const
+		{ return levels_[level].width; }
+
+		unsigned height(int level = 0) const
+		{ return levels_[level].height; }
+
+		// Same as Texture::select_level.
+		int select_level(
+			const IRasterizer::Vertex &v1,
+			const IRasterizer::Vertex &v2,
+			const IRasterizer::Vertex &v3,
+			int area2,
+			int u_index, int v_index) const
+		{
+			return detail::select_level(v1, v2, v3, area2, u_index, v_index,
+				levels_[0].width_log2, levels_[0].height_log2, level_count_);
+		}
+
+		// the texel at (x, y) of a level
+		pixel_type texel(unsigned x, unsigned y, int level, Cache &cache) const
+		{
+			return texel(levels_[level], x, y, cache);
+		}
+
+		pixel_type sample_nearest(int u, int v, int level, Cache &cache) const
+		{
+			const Level &l = levels_[level];
+			const unsigned x = static_cast<unsigned>(u >> (16 - l.width_log2)) & (l.width - 1);
+			const unsigned y = static_cast<unsigned>(v >> (16 - l.height_log2)) & (l.height - 1);
+			return texel(l, x, y, cache);
+		}
+
+		pixel_type sample_bilinear(int u, int v, int level, Cache &cache) const
+		{
+			const Level &l = levels_[level];
+
+			// texel coordinates in 24.8
+			const int tu = detail::to_texel8(u, l.width_log2) - 128;
+			const int tv = detail::to_texel8(v, l.height_log2) - 128;
+
+			const unsigned x0 = static_cast<unsigned>(tu >> 8) & (l.width - 1);
+			const unsigned y0 = static_cast<unsigned>(tv >> 8) & (l.height - 1);
+			const unsigned x1 = (x0 + 1) & (l.width - 1);
+			const unsigned y1 = (y0 + 1) & (l.height - 1);
+
+			return PixelFormat::bilinear(
+				texel(l, x0, y0, cache), texel(l, x1, y0, cache),
+				texel(l, x0, y1, cache), texel(l, x1, y1, cache),
+				tu & 0xff, tv & 0xff);
+		}
+
+	private:
+		struct Level {
+			unsigned width, height;
+			int width_log2, height_log2;
+			unsigned blocks_per_row;
+			size_t offset;
+		};
+
+		static unsigned blocks(unsigned size)
+		{ return (size + 3) >> 2; }
+
+		pixel_type texel(const Level &l, unsigned x, unsigned y, Cache &cache) const
+		{
+			const unsigned bx = x >> 2, by = y >> 2;
+			const uint8_t *block = &data_[l.offset + (by * l.blocks_per_row + bx) * ETC1::BLOCK_SIZE];
+			return cache.texels(block, bx, by)[(y & 3) * 4 + (x & 3)];
+		}
+
+		Level levels_[MAX_LEVELS];
+		int level_count_;
+		std::vector<uint8_t> data_;
+	};
+}
+
+#endif
@@ -0,0 +1,200 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef DEPTH_SPAN_H_
+#define DEPTH_SPAN_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "span.h"
+#include "framebuffer.h"
+#include "occlusion_query.h"
+
+#include <stdint.h>
+
+// Define SWR_NO_SIMD to always use the scalar code.
+#if !defined(SWR_NO_SIMD)
+#	if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#		define SWR_SSE2 1
+#		include <emmintrin.h>
+#	elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#		define SWR_NEON 1
+#		include <arm_neon.h>
+#	endif
+#endif
+
+namespace swr {
+	namespace detail {
+
+		// 16 bit depth of a 16.16 fixed point z value. Slightly negative
+		// values that come from rounding at the near plane are clamped to 0.
+		inline uint16_t depth16(int z)
+		{
+			z >>= 16;
+			return static_cast<uint16_t>(z < 0 ? 0 : z);
+		}
+
+		// Depth test with less or equal for n pixels. With DepthWrite every
+		// depth value becomes the minimum of itself and the interpolated z,
+		// otherwise the depth is only compared. Returns the number of pixels
+		// which passed the test. z and dz are 16.16 fixed point, the 16 bit
+		// depth is the integer part. The depth range of GeometryProcessor
+		// keeps it below 0x8000.
+		template <bool DepthWrite>
+		inline unsigned depth_span(uint16_t *depth, int z, int dz, unsigned n)
+		{
+			unsigned passed = 0;
+
+#if SWR_SSE2
+			if (n >= 8) {
+				// SSE2 only compares signed 16 bit values, so both sides are
+				// biased by 0x8000 to get the unsigned minimum.
+				const __m128i bias = _mm_set1_epi16(-0x8000);
+				const __m128i zero = _mm_setzero_si128();
+				const __m128i step = _mm_set1_epi32(dz * 8);
+				__m128i z0 = _mm_setr_epi32(z, z + dz, z + 2 * dz, z + 3 * dz);
+				__m128i z1 = _mm_add_epi32(z0, _mm_set1_epi32(dz * 4));
+				// counts the failed pixels per lane
+				__m128i failed = zero;
+				unsigned count = 0;
+
+				do {
+					__m128i d = _mm_packs_epi32(_mm_srai_epi32(z0, 16), _mm_srai_epi32(z1, 16));
+					d = _mm_xor_si128(_mm_max_epi16(d, zero), bias);
+
+					__m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depth));
+					old = _mm_xor_si128(old, bias);
+					failed = _mm_sub_epi16(failed, _mm_cmpgt_epi16(d, old));
+					if (DepthWrite)
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(depth),
+							_mm_xor_si128(_mm_min_epi16(old, d), bias));
+
+					z0 = _mm_add_epi32(z0, step);
+					z1 = _mm_add_epi32(z1, step);
+					z += dz * 8;
+					depth += 8;
+					n -= 8;
+					count += 8;
+				} while (n >= 8);
+
+				uint16_t lanes[8];
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), failed);
+				passed = count;
+				for (int i = 0; i < 8; ++i)
+					passed -= lanes[i];
+			}
+#elif SWR_NEON
+			if (n >= 8) {
+				const int32_t init[4] = { 0, dz, 2 * dz, 3 * dz };
+				const int32x4_t step = vdupq_n_s32(dz * 8);
+				int32x4_t z0 = vaddq_s32(vdupq_n_s32(z), vld1q_s32(init));
+				int32x4_t z1 = vaddq_s32(z0, vdupq_n_s32(dz * 4));
+				// counts the passed pixels per lane
+				uint16x8_t passed_lanes = vdupq_n_u16(0);
+
+				do {
+					// the saturating narrow also clamps negative values to 0
+					const uint16x8_t d = vcombine_u16(
+						vqmovun_s32(vshrq_n_s32(z0, 16)),
+						vqmovun_s32(vshrq_n_s32(z1, 16)));
+					const uint16x8_t old = vld1q_u16(depth);
+					passed_lanes = vsraq_n_u16(passed_lanes, vcleq_u16(d, old), 15);
+					if (DepthWrite)
+						vst1q_u16(depth, vminq_u16(old, d));
+
+					z0 = vaddq_s32(z0, step);
+					z1 = vaddq_s32(z1, step);
+					z += dz * 8;
+					depth += 8;
+					n -= 8;
+				} while (n >= 8);
+
+				uint16_t lanes[8];
+				vst1q_u16(lanes, passed_lanes);
+				for (int i = 0; i < 8; ++i)
+					passed += lanes[i];
+			}
+#endif
+			for (; n; --n) {
+				const uint16_t d = depth16(z);
+				if (d <= *depth) {
+					if (DepthWrite) *depth = d;
+					++passed;
+				}
+				z += dz;
+				++depth;
+			}
+
+			return passed;
+		}
+	}
+
+	// Span drawer for passes that only produce depth, like shadow maps or a
+	// depth prepass. The fragment shader is not called at all. It only has
+	// to provide a static framebuffer(userdata) function, set interpolate_z
+	// and have no varyings (varying_count = 0), which also makes the
+	// rasterizer skip perspective correction. The depth test is less or
+	// equal, so the framebuffer must have a 16 bit depth plane. For shadow
+	// maps a framebuffer without color plane can be used (see 
+	// BasicFramebuffer).
+	//
+	// A later color pass with a less or equal depth test then only shades
+	// the visible fragments. Its depth values must be computed the same way,
+	// so it should not use a depth offset.
+	//
+	// With DepthWrite = false the depth is only tested. Together with an
+	// occlusion query (see SpanDrawerBase::occlusion_query) this counts the
+	// visible pixels of a bounding volume without changing anything.
+	template <typename FragmentShader, bool DepthWrite = true>
+	struct SpanDrawerDepthOnly : public SpanDrawerBase<FragmentShader> {
+		static void affine_span(
+			int x,
+			int y,
+			IRasterizer::FragmentData fd,
+			const IRasterizer::FragmentData &step,
+			unsigned n,
+			void *userdata)
+		{
+			draw_span(FragmentShader::framebuffer(userdata), FragmentShader::occlusion_query(userdata),
+				x, y, fd.z, step.z, n);
+		}
+
+		template <typename ColorType>
+		static void draw_span(
+			BasicFramebuffer<ColorType, uint16_t> &fb,
+			OcclusionQuery *query,
+			int x,
+			int y,
+			int z,
+			int dz,
+			unsigned n)
+		{
+			typedef BasicFramebuffer<ColorType, uint16_t> FramebufferType;
+
+			// spans clipped away completely can arrive with a negative count
+			if (static_cast<int>(n) <= 0)
+				return;
+
+			assert(fb.has_depth());
+			fb.touch(x, y, n);
+
+			// tile boundaries split the span into contiguous pieces as in
+			// SpanDrawerFramebuffer
+			while (n) {
+				const unsigned tile_end = (x | (FramebufferType::TILE_SIZE - 1)) + 1;
+				const unsigned count = (std::min)(n, tile_end - x);
+
+				const unsigned passed = detail::depth_span<DepthWrite>(fb.depth_pointer(x, y), z, dz, count);
+				if (query)
+					query->add(x, y, passed);
+
+				z += dz * static_cast<int>(count);
+				x += count;
+				n -= count;
+			}
+		}
+	};
+}
+
+#endif
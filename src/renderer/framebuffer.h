@@ -0,0 +1,346 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef FRAMEBUFFER_H_
+#define FRAMEBUFFER_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <stdint.h>
+
+namespace swr {
+
+	namespace detail {
+		// malloc with the returned pointer aligned to alignment bytes, which
+		// must be a power of two. The original pointer is stored in front of
+		// the aligned block.
+		inline void* aligned_malloc(size_t size, size_t alignment)
+		{
+			char *p = static_cast<char*>(std::malloc(size + alignment + sizeof(void*)));
+			if (!p) return 0;
+			char *aligned = reinterpret_cast<char*>(
+				(reinterpret_cast<uintptr_t>(p + sizeof(void*)) + alignment - 1) & ~(uintptr_t(alignment) - 1));
+			reinterpret_cast<void**>(aligned)[-1] = p;
+			return aligned;
+		}
+
+		inline void aligned_free(void *p)
+		{
+			if (p) std::free(static_cast<void**>(p)[-1]);
+		}
+	}
+
+	// Memory layout of framebuffer planes. Linear planes store one row after
+	// the other. Tiled planes store 64x64 tiles one after the other with the
+	// rows of a tile in linear order, so that a rasterizer working on a tile
+	// touches only one contiguous block of memory.
+	enum FramebufferLayout {
+		FRAMEBUFFER_LINEAR,
+		FRAMEBUFFER_TILED
+	};
+
+	// A two dimensional array of pixels of type T with a pitch in bytes.
+	// The memory is either allocated by the plane, with the start of every
+	// row (or tile) aligned to a cache line, or it belongs to somebody else
+	// like the pixels of a window surface (see attach).
+	//
+	// In the tiled layout the TILE_SIZE pixels of a row within a tile are
+	// contiguous but row() and pitch() must not be used.
+	template <typename T>
+	class Plane {
+	public:
+		typedef T value_type;
+
+		static const int ALIGNMENT = 64;
+		static const int TILE_SIZE_LOG2 = 6;
+		static const int TILE_SIZE = 1 << TILE_SIZE_LOG2;
+
+		Plane() : 
+			data_(0), width_(0), height_(0), pitch_(0), 
+			layout_(FRAMEBUFFER_LINEAR), tiles_x_(0), owned_(false) 
+		{}
+
+		~Plane() { release(); }
+
+		void allocate(int width, int height, FramebufferLayout layout = FRAMEBUFFER_LINEAR)
+		{
+			release();
+			width_ = width;
+			height_ = height;
+			layout_ = layout;
+			tiles_x_ = (width + TILE_SIZE - 1) >> TILE_SIZE_LOG2;
+
+			size_t size;
+			if (layout == FRAMEBUFFER_TILED) {
+				const int tiles_y = (height + TILE_SIZE - 1) >> TILE_SIZE_LOG2;
+				pitch_ = TILE_SIZE * sizeof(T);
+				size = size_t(tiles_x_) * tiles_y * TILE_SIZE * TILE_SIZE * sizeof(T);
+			} else {
+				pitch_ = static_cast<int>(width * sizeof(T) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+				size = size_t(pitch_) * height;
+			}
+
+			data_ = static_cast<char*>(detail::aligned_malloc(size, ALIGNMENT));
+			owned_ = true;
+		}
+
+		// Uses external memory with pitch bytes per row. The memory must stay
+		// valid as long as it is attached.
+		void attach(void *data, int width, int height, int pitch)
+		{
+			release();
+			data_ = static_cast<char*>(data);
+			width_ = width;
+			height_ = height;
+			pitch_ = pitch;
+			layout_ = FRAMEBUFFER_LINEAR;
+		}
+
+		void release()
+		{
+			if (owned_) detail::aligned_free(data_);
+			data_ = 0;
+			owned_ = false;
+		}
+
+		bool empty() const { return data_ == 0; }
+		int width() const { return width_; }
+		int height() const { return height_; }
+		int pitch() const { return pitch_; }
+		FramebufferLayout layout() const { return layout_; }
+
+		T* row(int y)
+		{ assert(layout_ == FRAMEBUFFER_LINEAR); return reinterpret_cast<T*>(data_ + y * pitch_); }
+
+		const T* row(int y) const
+		{ assert(layout_ == FRAMEBUFFER_LINEAR); return reinterpret_cast<const T*>(data_ + y * pitch_); }
+
+		T* pointer(int x, int y)
+		{ return reinterpret_cast<T*>(data_ + offset(x, y)); }
+
+		const T* pointer(int x, int y) const
+		{ return reinterpret_cast<const T*>(data_ + offset(x, y)); }
+
+	private:
+		// not copyable
+		Plane(const Plane&);
+		Plane& operator=(const Plane&);
+
+		size_t offset(int x, int y) const
+		{
+			if (layout_ == FRAMEBUFFER_LINEAR)
+				return size_t(y) * pitch_ + x * sizeof(T);
+
+			const size_t tile = (y >> TILE_SIZE_LOG2) * tiles_x_ + (x >> TILE_SIZE_LOG2);
+			const size_t inner = ((y & (TILE_SIZE - 1)) << TILE_SIZE_LOG2) + (x & (TILE_SIZE - 1));
+			return ((tile << (2 * TILE_SIZE_LOG2)) + inner) * sizeof(T);
+		}
+
+		char *data_;
+		int width_, height_;
+		int pitch_;
+		FramebufferLayout layout_;
+		int tiles_x_;
+		bool owned_;
+	};
+
+	// A color plane and an optional depth plane which are cleared lazily.
+	//
+	// clear() does not touch the pixels. It only remembers the clear values
+	// and marks every row of every 64x64 tile as cleared. A span drawer calls
+	// touch() before it writes to a row of pixels, which fills the cleared
+	// rows of the affected tiles with the clear values. present() copies the
+	// color buffer to its destination and writes the clear color for the rows
+	// that were never touched. So depth is only cleared where something is
+	// drawn and untouched color is written once instead of twice. When the
+	// color plane is attached to the destination itself resolve() only fills
+	// what is left.
+	//
+	// Tile rows are tracked with one bit each. Threads drawing into the same
+	// framebuffer must not share a tile, so the regions of a parallel
+	// rasterizer have to be aligned to TILE_SIZE (RasterizerParallel does
+	// that). With the tiled layout each of these threads then also works on
+	// its own memory without sharing cache lines with the others.
+	template <typename ColorType, typename DepthType = uint16_t>
+	class BasicFramebuffer {
+	public:
+		typedef ColorType color_type;
+		typedef DepthType depth_type;
+
+		static const int TILE_SIZE_LOG2 = Plane<ColorType>::TILE_SIZE_LOG2;
+		static const int TILE_SIZE = 1 << TILE_SIZE_LOG2;
+
+		// Allocates the color plane and, if with_depth is set, the depth
+		// plane with the given layout.
+		BasicFramebuffer(int width, int height, bool with_depth = true,
+			FramebufferLayout layout = FRAMEBUFFER_LINEAR) :
+			width_(width),
+			height_(height),
+			tiles_x_((width + TILE_SIZE - 1) >> TILE_SIZE_LOG2),
+			tiles_y_((height + TILE_SIZE - 1) >> TILE_SIZE_LOG2),
+			clear_color_(0),
+			clear_depth_(~DepthType(0)),
+			cleared_rows_(tiles_x_ * tiles_y_)
+		{
+			color_.allocate(width, height, layout);
+			if (with_depth)
+				depth_.allocate(width, height, layout);
+			clear(clear_color_, clear_depth_);
+		}
+
+		// Renders into external color memory with pitch bytes per row, like
+		// the pixels of a window. Only the depth plane is allocated. With
+		// pixels = 0 there is no color plane at all, which is all a shadow
+		// map needs.
+		BasicFramebuffer(void *pixels, int width, int height, int pitch, bool with_depth = true) :
+			width_(width),
+			height_(height),
+			tiles_x_((width + TILE_SIZE - 1) >> TILE_SIZE_LOG2),
+			tiles_y_((height + TILE_SIZE - 1) >> TILE_SIZE_LOG2),
+			clear_color_(0),
+			clear_depth_(~DepthType(0)),
+			cleared_rows_(tiles_x_ * tiles_y_)
+		{
+			color_.attach(pixels, width, height, pitch);
+			if (with_depth)
+				depth_.allocate(width, height);
+			clear(clear_color_, clear_depth_);
+		}
+
+		int width() const { return width_; }
+		int height() const { return height_; }
+		bool has_color() const { return !color_.empty(); }
+		bool has_depth() const { return !depth_.empty(); }
+
+		Plane<ColorType>& color() { return color_; }
+		const Plane<ColorType>& color() const { return color_; }
+		Plane<DepthType>& depth() { return depth_; }
+		const Plane<DepthType>& depth() const { return depth_; }
+
+		// Switches the color plane to external memory, for instance when it
+		// moved.
+		void attach_color(void *pixels, int pitch)
+		{
+			color_.attach(pixels, width_, height_, pitch);
+		}
+
+		ColorType* color_pointer(int x, int y)
+		{ return color_.pointer(x, y); }
+
+		DepthType* depth_pointer(int x, int y)
+		{ return depth_.pointer(x, y); }
+
+		// Marks the whole framebuffer as cleared. Costs one bit per pixel row
+		// of a tile and no pixel writes.
+		void clear(ColorType color, DepthType depth)
+		{
+			clear_color_ = color;
+			clear_depth_ = depth;
+			for (size_t i = 0; i < cleared_rows_.size(); ++i)
+				cleared_rows_[i] = ~uint64_t(0);
+		}
+
+		ColorType clear_color() const { return clear_color_; }
+		DepthType clear_depth() const { return clear_depth_; }
+
+		// Makes the n pixels starting at (x, y) valid so that they can be read
+		// and written. Only the rows of tiles that are still cleared are
+		// filled with the clear values.
+		void touch(int x, int y, unsigned n)
+		{
+			if (static_cast<int>(n) <= 0) return;
+			assert(x >= 0 && x + static_cast<int>(n) <= width_ && y >= 0 && y < height_);
+
+			const uint64_t bit = uint64_t(1) << (y & (TILE_SIZE - 1));
+			uint64_t *rows = &cleared_rows_[(y >> TILE_SIZE_LOG2) * tiles_x_];
+
+			const int last = (x + n - 1) >> TILE_SIZE_LOG2;
+			for (int tx = x >> TILE_SIZE_LOG2; tx <= last; ++tx) {
+				if (rows[tx] & bit) {
+					rows[tx] &= ~bit;
+					fill_row(tx, y);
+				}
+			}
+		}
+
+		// Writes the clear values to all pixels that are still cleared.
+		// Needed before reading the planes directly.
+		void resolve()
+		{
+			for (int ty = 0; ty < tiles_y_; ++ty) {
+				for (int tx = 0; tx < tiles_x_; ++tx) {
+					uint64_t &rows = cleared_rows_[ty * tiles_x_ + tx];
+					for (int y = ty << TILE_SIZE_LOG2; rows && y < height_; ++y) {
+						const uint64_t bit = uint64_t(1) << (y & (TILE_SIZE - 1));
+						if (rows & bit)
+							fill_row(tx, y);
+						rows &= ~bit;
+					}
+				}
+			}
+		}
+
+		// Copies the color plane to dst which has pitch bytes per row.
+		// Cleared rows of tiles are filled with the clear color instead of
+		// being copied, the framebuffer itself is not changed. Works in
+		// pieces of one tile row, which also converts the tiled layout to
+		// the linear one of dst.
+		void present(void *dst, int pitch) const
+		{
+			assert(has_color());
+			for (int y = 0; y < height_; ++y) {
+				ColorType *out = reinterpret_cast<ColorType*>(static_cast<char*>(dst) + y * pitch);
+				const uint64_t bit = uint64_t(1) << (y & (TILE_SIZE - 1));
+				const uint64_t *rows = &cleared_rows_[(y >> TILE_SIZE_LOG2) * tiles_x_];
+
+				for (int tx = 0; tx < tiles_x_; ++tx) {
+					const int x = tx << TILE_SIZE_LOG2;
+					const int n = (std::min)(int(TILE_SIZE), width_ - x);
+					if (rows[tx] & bit)
+						std::fill(out + x, out + x + n, clear_color_);
+					else
+						std::memcpy(out + x, color_.pointer(x, y), n * sizeof(ColorType));
+				}
+			}
+		}
+
+	private:
+		// not copyable
+		BasicFramebuffer(const BasicFramebuffer&);
+		BasicFramebuffer& operator=(const BasicFramebuffer&);
+
+		void fill_row(int tx, int y)
+		{
+			const int x = tx << TILE_SIZE_LOG2;
+			const int n = (std::min)(int(TILE_SIZE), width_ - x);
+			if (has_color())
+				std::fill(color_.pointer(x, y), color_.pointer(x, y) + n, clear_color_);
+			if (has_depth())
+				std::fill(depth_.pointer(x, y), depth_.pointer(x, y) + n, clear_depth_);
+		}
+
+		int width_, height_;
+		int tiles_x_, tiles_y_;
+		ColorType clear_color_;
+		DepthType clear_depth_;
+		Plane<ColorType> color_;
+		Plane<DepthType> depth_;
+
+		// one bit for every row of a tile that still has to be cleared
+		std::vector<uint64_t> cleared_rows_;
+	};
+
+	// 16 bit color (e.g. RGB565) and 16 bit depth
+	typedef BasicFramebuffer<uint16_t, uint16_t> Framebuffer;
+
+	// 32 bit color (e.g. RGBA8888) and 16 bit depth
+	typedef BasicFramebuffer<uint32_t, uint16_t> Framebuffer32;
+}
+
+#endif
@@ -0,0 +1,50 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef FRAMEBUFFER_SDL_H_
+#define FRAMEBUFFER_SDL_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+// Optional glue between BasicFramebuffer and SDL surfaces. The renderer
+// itself does not depend on SDL, so this is only included by programs that
+// use it.
+
+#include "SDL.h"
+#include "framebuffer.h"
+
+namespace swr {
+
+	// Makes the framebuffer render directly into the pixels of the surface.
+	// The surface must be locked and have the size and pixel size of the
+	// framebuffer. Attach again after every lock since SDL may move the
+	// pixels of hardware surfaces.
+	template <typename ColorType, typename DepthType>
+	void attach_surface(BasicFramebuffer<ColorType, DepthType> &fb, SDL_Surface *surface)
+	{
+		assert(surface->w == fb.width() && surface->h == fb.height());
+		assert(surface->format->BytesPerPixel == sizeof(ColorType));
+		fb.attach_color(surface->pixels, surface->pitch);
+	}
+
+	// Copies the color plane of the framebuffer to the surface. Returns
+	// false if the surface could not be locked.
+	template <typename ColorType, typename DepthType>
+	bool present(const BasicFramebuffer<ColorType, DepthType> &fb, SDL_Surface *surface)
+	{
+		assert(surface->w == fb.width() && surface->h == fb.height());
+		assert(surface->format->BytesPerPixel == sizeof(ColorType));
+
+		if (SDL_MUSTLOCK(surface) && SDL_LockSurface(surface) != 0)
+			return false;
+
+		fb.present(surface->pixels, surface->pitch);
+
+		if (SDL_MUSTLOCK(surface))
+			SDL_UnlockSurface(surface);
+		return true;
+	}
+}
+
+#endif
@@ -122,6 +122,9 @@ namespace swr {
 void GeometryProcessor::process_begin() {}
 
 GeometryProcessor::VertexOutput* GeometryProcessor::acquire_output_location() {
+	// the vertex processor shades at most one vertex per index of a batch,
+	// the rest of vertices_ is left for clipping
+	assert(vertices_.size() < MAX_INDICES);
 	vertices_.resize(vertices_.size() + 1);
 	return &vertices_.back();
 }
@@ -221,62 +224,62 @@ void GeometryProcessor::clip_triangles()
 {
 	using namespace detail;
 
+	triangles_.clear();
+
 	int mask = 0;
 	for (size_t i = 0, n = vertices_.size(); i < n; ++i)
 		mask |= calc_clip_mask(vertices_[i]);
 
-	if (mask != 0) {
-		for (size_t idx = 0, count = indices_.size(); idx + 3 <= count; idx += 3) {
-			int vlist[2][2*6+1];
-			int *inlist = vlist[0], *outlist = vlist[1];
-			int n = 3;
-
-			inlist[0] = indices_[idx];
-			inlist[1] = indices_[idx + 1];
-			inlist[2] = indices_[idx + 2];
-
-			// mark this triangle as unused in case it should be completely 
-			// clipped
-			indices_[idx] = SKIP_FLAG;
-			indices_[idx + 1] = SKIP_FLAG;
-			indices_[idx + 2] = SKIP_FLAG;
-
-			POLY_CLIP(CLIP_POS_X_BIT, -1,  0,  0, 1);
-			POLY_CLIP(CLIP_NEG_X_BIT,  1,  0,  0, 1);
-			POLY_CLIP(CLIP_POS_Y_BIT,  0, -1,  0, 1);
-			POLY_CLIP(CLIP_NEG_Y_BIT,  0,  1,  0, 1);
-			POLY_CLIP(CLIP_POS_Z_BIT,  0,  0, -1, 1);
-			POLY_CLIP(CLIP_NEG_Z_BIT,  0,  0,  1, 1);
-
-			// transform the poly in inlist into triangles
-			indices_[idx] = inlist[0];
-			indices_[idx + 1] = inlist[1];
-			indices_[idx + 2] = inlist[2];
-			for (int i = 3; i < n; ++i) {
-				indices_.push_back(inlist[0]);
-				indices_.push_back(inlist[i - 1]);
-				indices_.push_back(inlist[i]);
-			}
+	if (mask == 0) {
+		for (size_t i = 0, n = indices_.size(); i < n; ++i)
+			triangles_.push_back(indices_[i]);
+		return;
+	}
+
+	for (size_t idx = 0, count = indices_.size(); idx + 3 <= count; idx += 3) {
+		int vlist[2][2*6+1];
+		int *inlist = vlist[0], *outlist = vlist[1];
+		int n = 3;
+
+		inlist[0] = indices_[idx];
+		inlist[1] = indices_[idx + 1];
+		inlist[2] = indices_[idx + 2];
+
+		// a completely clipped triangle continues with the next one 
+		// without adding anything
+		POLY_CLIP(CLIP_POS_X_BIT, -1,  0,  0, 1);
+		POLY_CLIP(CLIP_NEG_X_BIT,  1,  0,  0, 1);
+		POLY_CLIP(CLIP_POS_Y_BIT,  0, -1,  0, 1);
+		POLY_CLIP(CLIP_NEG_Y_BIT,  0,  1,  0, 1);
+		POLY_CLIP(CLIP_POS_Z_BIT,  0,  0, -1, 1);
+		POLY_CLIP(CLIP_NEG_Z_BIT,  0,  0,  1, 1);
+
+		// transform the poly in inlist into triangles
+		for (int i = 2; i < n; ++i) {
+			triangles_.push_back(inlist[0]);
+			triangles_.push_back(inlist[i - 1]);
+			triangles_.push_back(inlist[i]);
 		}
 	}
 }
 
 
-// perspective divide and viewport transform of vertices
-void GeometryProcessor::pdiv_and_vt()
+// perspective divide and viewport transform of the vertices used by the
+// given indices
+void GeometryProcessor::pdiv_and_vt(const unsigned *indices, size_t count)
 {
 	using namespace detail;
 
 	static_vector<bool, MAX_VERTICES_INDICES> already_processed;
 	already_processed.resize(vertices_.size(), false);
 
-	for (size_t i = 0; i < indices_.size(); ++i) {
-		// don't process triangles which are marked as unused by clipping
-		if (indices_[i] == SKIP_FLAG) continue;
+	for (size_t i = 0; i < count; ++i) {
+		// don't process primitives which are marked as unused by clipping
+		if (indices[i] == SKIP_FLAG) continue;
 
-		if (!already_processed[indices_[i]]) {
+		if (!already_processed[indices[i]]) {
 			// perspective divide
-			VertexOutput &v = vertices_[indices_[i]];
+			VertexOutput &v = vertices_[indices[i]];
 #if 0
 			v.x = fixdiv<16>(v.x, v.w);
 			v.y = fixdiv<16>(v.y, v.w);
@@ -298,7 +301,7 @@ void GeometryProcessor::pdiv_and_vt()
 			v.y = (viewport_.py * -v.y + viewport_.oy) >> 12;
 			v.z = fixmul<16>(depth_range_.fmndiv2,v.z) + depth_range_.npfdiv2;
 
-			already_processed[indices_[i]] = true;
+			already_processed[indices[i]] = true;
 		}
 	}
 }
@@ -306,44 +309,45 @@ void GeometryProcessor::pdiv_and_vt()
 void GeometryProcessor::process_triangles()
 {
 	clip_triangles();
-	pdiv_and_vt();
-	
-	// compute facing and possibly cull and then draw the triangles
-	for (size_t i = 0; i + 3 <= indices_.size(); i += 3) {
-		// don't process triangles which are marked as unused by clipping
-		if (indices_[i] == detail::SKIP_FLAG)
-			continue;
-
-		VertexOutput &v0 = vertices_[indices_[i]];
-		VertexOutput &v1 = vertices_[indices_[i + 1]];
-		VertexOutput &v2 = vertices_[indices_[i + 2]];
+	pdiv_and_vt(&triangles_[0], triangles_.size());
+
+	// compute facing and possibly cull. The remaining triangles are moved
+	// to the front of the list and made counter clockwise.
+	size_t out = 0;
+	for (size_t i = 0; i + 3 <= triangles_.size(); i += 3) {
+		unsigned i0 = triangles_[i];
+		unsigned i1 = triangles_[i + 1];
+		unsigned i2 = triangles_[i + 2];
+
+		const VertexOutput &v0 = vertices_[i0];
+		const VertexOutput &v1 = vertices_[i1];
+		const VertexOutput &v2 = vertices_[i2];
 
 		// here x and y are in 28.4 fixed point. I don't use the fixmul<4>
 		// here since these coordinates are clipped to the viewport and
 		// therefore are sufficiently small to not overflow.
 		int facing = (v0.x-v1.x)*(v2.y-v1.y)-(v2.x-v1.x)*(v0.y-v1.y);
 		if (facing > 0) {
-			if (cull_mode_ != CULL_CCW) {
-				// Draw triangle with the current indices.
-			} else {
-				// Delete triangle
-				indices_[i] = indices_[i + 1] = indices_[i + 2] = 0;
-			}
+			if (cull_mode_ == CULL_CCW)
+				continue;
 		}
 		else {
-			if (cull_mode_ != CULL_CW) {
-				std::swap(indices_[i], indices_[i + 2]);
-				rasterizer_->draw_triangle(v2, v1, v0);
-			} else {
-				indices_[i] = indices_[i + 1] = indices_[i + 2] = 0;
-			}
+			if (cull_mode_ == CULL_CW)
+				continue;
+			std::swap(i0, i2);
 		}
+
+		triangles_[out++] = i0;
+		triangles_[out++] = i1;
+		triangles_[out++] = i2;
 	}
+	triangles_.resize(out);
 
-	rasterizer_->draw_triangle_list(&vertices_[0], &indices_[0], indices_.size());
+	rasterizer_->draw_triangle_list(&vertices_[0], &triangles_[0], triangles_.size());
 
 	vertices_.clear();
 	indices_.clear();
+	triangles_.clear();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -401,7 +405,7 @@ void GeometryProcessor::clip_lines()
 void GeometryProcessor::process_lines()
 {
 	clip_lines();
-	pdiv_and_vt();
+	pdiv_and_vt(&indices_[0], indices_.size());
 
 	rasterizer_->draw_line_list(&vertices_[0], &indices_[0], indices_.size());
 
@@ -433,7 +437,7 @@ void GeometryProcessor::clip_points()
 void GeometryProcessor::process_points()
 {
 	clip_points();
-	pdiv_and_vt();
+	pdiv_and_vt(&indices_[0], indices_.size());
 
 	rasterizer_->draw_point_list(&vertices_[0], &indices_[0], indices_.size());
 
@@ -466,22 +470,92 @@ void GeometryProcessor::vertex_attrib_pointer(int n, int stride, const void* buf
 	Base::vertex_attrib_pointer(n, stride, buffer);
 }
 
-void GeometryProcessor::draw_triangles(unsigned count, unsigned *indices)
+void GeometryProcessor::uniforms(const void *uniforms)
+{
+	Base::uniforms(uniforms);
+}
+
+void GeometryProcessor::vertex_attrib_divisor(int n, unsigned divisor)
+{
+	Base::vertex_attrib_divisor(n, divisor);
+}
+
+template <typename IndexType>
+void GeometryProcessor::draw(DrawMode mode, Base::Topology topology, unsigned count, const IndexType *indices,
+	unsigned instance_count)
+{
+	draw_mode_ = mode;
+
+	// drop incomplete primitives at the end of a list, otherwise with
+	// instancing they would take their missing vertices from the next instance
+	if (topology == Base::TOPOLOGY_LIST) {
+		if (mode == DM_TRIANGLES)
+			count = count / 3 * 3;
+		else if (mode == DM_LINES)
+			count = count / 2 * 2;
+	}
+
+	Base::process(count, indices, topology, instance_count);
+}
+
+void GeometryProcessor::draw_triangles(unsigned count, const uint16_t *indices)
+{
+	draw(DM_TRIANGLES, Base::TOPOLOGY_LIST, count, indices);
+}
+
+void GeometryProcessor::draw_triangles(unsigned count, const uint32_t *indices)
+{
+	draw(DM_TRIANGLES, Base::TOPOLOGY_LIST, count, indices);
+}
+
+void GeometryProcessor::draw_triangles_instanced(unsigned count, const uint16_t *indices, unsigned instance_count)
 {
-	draw_mode_ = DM_TRIANGLES;
-	Base::process(count, indices);
+	draw(DM_TRIANGLES, Base::TOPOLOGY_LIST, count, indices, instance_count);
 }
 
-void GeometryProcessor::draw_lines(unsigned count, unsigned *indices)
+void GeometryProcessor::draw_triangles_instanced(unsigned count, const uint32_t *indices, unsigned instance_count)
 {
-	draw_mode_ = DM_LINES;
-	Base::process(count, indices);
+	draw(DM_TRIANGLES, Base::TOPOLOGY_LIST, count, indices, instance_count);
 }
 
-void GeometryProcessor::draw_points(unsigned count, unsigned *indices)
+void GeometryProcessor::draw_triangle_strip(unsigned count, const uint16_t *indices)
 {
-	draw_mode_ = DM_POINTS;
-	Base::process(count, indices);
+	draw(DM_TRIANGLES, Base::TOPOLOGY_STRIP, count, indices);
+}
+
+void GeometryProcessor::draw_triangle_strip(unsigned count, const uint32_t *indices)
+{
+	draw(DM_TRIANGLES, Base::TOPOLOGY_STRIP, count, indices);
+}
+
+void GeometryProcessor::draw_triangle_fan(unsigned count, const uint16_t *indices)
+{
+	draw(DM_TRIANGLES, Base::TOPOLOGY_FAN, count, indices);
+}
+
+void GeometryProcessor::draw_triangle_fan(unsigned count, const uint32_t *indices)
+{
+	draw(DM_TRIANGLES, Base::TOPOLOGY_FAN, count, indices);
+}
+
+void GeometryProcessor::draw_lines(unsigned count, const uint16_t *indices)
+{
+	draw(DM_LINES, Base::TOPOLOGY_LIST, count, indices);
+}
+
+void GeometryProcessor::draw_lines(unsigned count, const uint32_t *indices)
+{
+	draw(DM_LINES, Base::TOPOLOGY_LIST, count, indices);
+}
+
+void GeometryProcessor::draw_points(unsigned count, const uint16_t *indices)
+{
+	draw(DM_POINTS, Base::TOPOLOGY_LIST, count, indices);
+}
+
+void GeometryProcessor::draw_points(unsigned count, const uint32_t *indices)
+{
+	draw(DM_POINTS, Base::TOPOLOGY_LIST, count, indices);
 }
 
 void GeometryProcessor::cull_mode(CullMode m)
@@ -489,4 +563,9 @@ void GeometryProcessor::cull_mode(CullMode m)
 	cull_mode_ = m;
 }
 
+void GeometryProcessor::restart_index(unsigned index)
+{
+	Base::restart_index(index);
+}
+
 } // end namespace swr
@@ -115,13 +115,49 @@ public:
 
 	void vertex_attrib_pointer(int n, int stride, const void* buffer);
 
-	// count gives the number of indices
-	void draw_triangles(unsigned count, unsigned *indices);
-	void draw_lines(unsigned count, unsigned *indices);
-	void draw_points(unsigned count, unsigned *indices);
+	// Constant data of the vertex shader for the following draw calls (see
+	// VertexProcessor::uniforms). Like the userdata of the rasterizer, but
+	// typed by the vertex shader's uniform_type. With this two geometry
+	// processors can use the same vertex shader with different data.
+	void uniforms(const void *uniforms);
+
+	// Makes attribute n a per instance attribute for instanced drawing. It
+	// advances by one element every divisor instances. 0 makes it a per
+	// vertex attribute again.
+	void vertex_attrib_divisor(int n, unsigned divisor);
+
+	// count gives the number of indices. The indices are 16 or 32 bit, 16
+	// bit indices need only half the memory bandwidth.
+	void draw_triangles(unsigned count, const uint16_t *indices);
+	void draw_triangles(unsigned count, const uint32_t *indices);
+
+	// Draws the triangles instance_count times. The vertex shader sees the
+	// per instance attributes of the current instance, for instance a model
+	// matrix, instead of having to read them from static variables which 
+	// change between draw calls. All instances are processed in the same
+	// batches.
+	void draw_triangles_instanced(unsigned count, const uint16_t *indices, unsigned instance_count);
+	void draw_triangles_instanced(unsigned count, const uint32_t *indices, unsigned instance_count);
+
+	// Every index after the first two adds a triangle with the previous two
+	// vertices (strip) or with the first and the previous vertex (fan). The
+	// two shared vertices are not shaded again. The restart index ends the
+	// strip or fan and starts a new one.
+	void draw_triangle_strip(unsigned count, const uint16_t *indices);
+	void draw_triangle_strip(unsigned count, const uint32_t *indices);
+	void draw_triangle_fan(unsigned count, const uint16_t *indices);
+	void draw_triangle_fan(unsigned count, const uint32_t *indices);
+
+	void draw_lines(unsigned count, const uint16_t *indices);
+	void draw_lines(unsigned count, const uint32_t *indices);
+	void draw_points(unsigned count, const uint16_t *indices);
+	void draw_points(unsigned count, const uint32_t *indices);
 
 	void cull_mode(CullMode m);
 
+	// the index that restarts strips and fans, by default 0xffffffff
+	void restart_index(unsigned index);
+
 	template <typename VertexShader>
 	void vertex_shader()
 	{
@@ -139,7 +175,7 @@ private:
 private:
 	void add_interp_vertex(int t, int out, int in);
 
-	void pdiv_and_vt();
+	void pdiv_and_vt(const unsigned *indices, size_t count);
 
 	void clip_triangles();
 	void process_triangles();
@@ -173,6 +209,10 @@ private:
 		MAX_TRIANGLES * 3 + 
 		MAX_TRIANGLES * 12; // Clipping generates additional vertices
 
+	// the indices as they come from the vertex processor, at most one batch
+	// of triangles, lines or points
+	static const unsigned MAX_INDICES = MAX_TRIANGLES * 3;
+
 	enum DrawMode {
 		DM_TRIANGLES,
 		DM_LINES,
@@ -181,8 +221,16 @@ private:
 
 	DrawMode draw_mode_;
 
+	template <typename IndexType>
+	void draw(DrawMode mode, Base::Topology topology, unsigned count, const IndexType *indices,
+		unsigned instance_count = 1);
+
 	detail::static_vector<VertexOutput, MAX_VERTICES_INDICES> vertices_;
-	detail::static_vector<unsigned, MAX_VERTICES_INDICES> indices_;
+	detail::static_vector<unsigned, MAX_INDICES> indices_;
+
+	// The triangles which are left after clipping and culling. Separate 
+	// from indices_, so that the input of a batch is never modified.
+	detail::static_vector<unsigned, MAX_VERTICES_INDICES> triangles_;
 
 	struct {
 		int ox, oy; // origin x and y
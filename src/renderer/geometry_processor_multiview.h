@@ -0,0 +1,244 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef GEOMETRYPROCESSOR_MULTIVIEW_H_
+#define GEOMETRYPROCESSOR_MULTIVIEW_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "irasterizer.h"
+#include "geometry_processor.h"
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cassert>
+
+namespace swr {
+
+namespace detail {
+	// Calls VertexShader::view_transform(view, out) or, if the vertex shader
+	// declares a uniform_type, VertexShader::view_transform(view, out,
+	// uniforms). See ShadeCall.
+	template <typename VertexShader, bool HasUniforms = has_uniform_type<VertexShader>::value>
+	struct ViewTransformCall {
+		template <typename VertexOutput>
+		static void view_transform(unsigned view, VertexOutput &out, const void *)
+		{ VertexShader::view_transform(view, out); }
+	};
+
+	template <typename VertexShader>
+	struct ViewTransformCall<VertexShader, true> {
+		template <typename VertexOutput>
+		static void view_transform(unsigned view, VertexOutput &out, const void *uniforms)
+		{
+			VertexShader::view_transform(view, out,
+				*static_cast<const typename VertexShader::uniform_type*>(uniforms));
+		}
+	};
+}
+
+// Draws the same geometry into several views, like the two eyes of a
+// stereo image, the six faces of a cube shadow map or split screen. Every
+// view has its own GeometryProcessor with its own rasterizer, viewport and
+// cull mode.
+//
+// The vertex shader is split in two parts. shade(in, out) is called once
+// per vertex for all views. It fetches the attributes, does the expensive
+// work like skinning and lighting and writes the varyings. It also writes a
+// view independent position (e.g. in world space) to x, y, z and w. Then
+// view_transform(view, out) is called for each view with a copy of that
+// output and only has to turn the position into the clip space of the view.
+// Both take the uniforms as a third argument if the shader declares a
+// uniform_type.
+//
+// With a thread_count above 1 the views are processed in parallel. Then the
+// views must not draw into the same framebuffer tiles, which is the case for
+// separate framebuffers.
+class GeometryProcessorMultiView {
+public:
+	typedef GeometryProcessor::VertexInput VertexInput;
+	typedef GeometryProcessor::VertexOutput VertexOutput;
+
+	static const int MAX_ATTRIBUTES = GeometryProcessor::MAX_ATTRIBUTES;
+
+	GeometryProcessorMultiView() :
+		thread_count_(1),
+		shade_func16_(0),
+		shade_func32_(0),
+		view_shader_(0),
+		uniforms_(0)
+	{}
+
+	// Adds a view which is drawn with rasterizer r. Returns the index of the
+	// view.
+	unsigned add_view(IRasterizer *r)
+	{
+		views_.push_back(View(r));
+		if (view_shader_)
+			view_shader_(views_.back().geometry_processor);
+		return static_cast<unsigned>(views_.size() - 1);
+	}
+
+	unsigned view_count() const { return static_cast<unsigned>(views_.size()); }
+
+	// The geometry processor of a view, to set its viewport, depth range or
+	// cull mode. Its vertex shader, attributes and uniforms are set by the
+	// multi-view processor.
+	GeometryProcessor& view(unsigned i) { return views_[i].geometry_processor; }
+
+	void thread_count(int n) { thread_count_ = n; }
+	int thread_count() const { return thread_count_; }
+
+	void vertex_attrib_pointer(int n, int stride, const void* buffer)
+	{
+		assert(n >= 0 && n < MAX_ATTRIBUTES);
+		attributes_[n].stride = stride;
+		attributes_[n].buffer = static_cast<const char*>(buffer);
+	}
+
+	void uniforms(const void *uniforms)
+	{ uniforms_ = uniforms; }
+
+	template <typename VertexShader>
+	void vertex_shader()
+	{
+		shade_func16_ = &GeometryProcessorMultiView::shade_template<VertexShader, uint16_t>;
+		shade_func32_ = &GeometryProcessorMultiView::shade_template<VertexShader, uint32_t>;
+		view_shader_ = &view_shader_template<VertexShader>;
+		for (size_t i = 0; i < views_.size(); ++i)
+			view_shader_(views_[i].geometry_processor);
+	}
+
+	void draw_triangles(unsigned count, const uint16_t *indices)
+	{
+		if (shade_func16_) {
+			(this->*shade_func16_)(count, indices);
+			draw_views(count, indices);
+		}
+	}
+
+	void draw_triangles(unsigned count, const uint32_t *indices)
+	{
+		if (shade_func32_) {
+			(this->*shade_func32_)(count, indices);
+			draw_views(count, indices);
+		}
+	}
+
+private:
+	// The uniforms of a view's geometry processor: the view index and the
+	// uniforms of the vertex shader.
+	struct ViewUniforms {
+		unsigned view;
+		const void *uniforms;
+	};
+
+	// Vertex shader of the views. Its only attribute is the shared output
+	// of the multi-view vertex shader.
+	template <typename VertexShader>
+	struct ViewShader {
+		static const unsigned attribute_count = 1;
+		static const unsigned varying_count = VertexShader::varying_count;
+
+		typedef ViewUniforms uniform_type;
+
+		static void shade(const VertexInput in, VertexOutput &out, const ViewUniforms &u)
+		{
+			out = *static_cast<const VertexOutput*>(in[0]);
+			detail::ViewTransformCall<VertexShader>::view_transform(u.view, out, u.uniforms);
+		}
+	};
+
+	template <typename VertexShader>
+	static void view_shader_template(GeometryProcessor &g)
+	{ g.vertex_shader<ViewShader<VertexShader> >(); }
+
+	struct View {
+		GeometryProcessor geometry_processor;
+		ViewUniforms uniforms;
+
+		explicit View(IRasterizer *r) : geometry_processor(r) {}
+	};
+
+	// Calls the view independent part of the vertex shader once for every
+	// vertex used by the indices. The work is proportional to count: the
+	// buffers only grow, and afterwards only the flags of the shaded vertices
+	// are reset.
+	template <typename VertexShader, typename IndexType>
+	void shade_template(unsigned count, const IndexType *indices)
+	{
+		unsigned max_index = 0;
+		for (unsigned i = 0; i < count; ++i)
+			max_index = (std::max)(max_index, static_cast<unsigned>(indices[i]));
+
+		if (shared_.size() <= max_index) {
+			shared_.resize(max_index + 1);
+			shaded_.resize(max_index + 1, false);
+		}
+
+		VertexInput in;
+		for (unsigned i = 0; i < count; ++i) {
+			const unsigned index = indices[i];
+			if (shaded_[index])
+				continue;
+
+			for (unsigned a = 0; a < VertexShader::attribute_count; ++a)
+				in[a] = attributes_[a].buffer + index * attributes_[a].stride;
+
+			detail::ShadeCall<VertexShader>::shade(in, shared_[index], uniforms_);
+			shaded_[index] = true;
+			touched_.push_back(index);
+		}
+
+		for (size_t i = 0; i < touched_.size(); ++i)
+			shaded_[touched_[i]] = false;
+		touched_.clear();
+	}
+
+	template <typename IndexType>
+	void draw_views(unsigned count, const IndexType *indices)
+	{
+		if (!count)
+			return;
+
+		#pragma omp parallel for num_threads(thread_count_)
+		for (int i = 0; i < (int) views_.size(); ++i) {
+			View &v = views_[i];
+			v.uniforms.view = i;
+			v.uniforms.uniforms = uniforms_;
+			v.geometry_processor.uniforms(&v.uniforms);
+			v.geometry_processor.vertex_attrib_pointer(0, sizeof(VertexOutput), &shared_[0]);
+			v.geometry_processor.draw_triangles(count, indices);
+		}
+	}
+
+	struct Attribute {
+		int stride;
+		const char *buffer;
+		Attribute() : stride(0), buffer(0) {}
+	} attributes_[MAX_ATTRIBUTES];
+
+	int thread_count_;
+	std::vector<View> views_;
+
+	void (GeometryProcessorMultiView::*shade_func16_)(unsigned, const uint16_t*);
+	void (GeometryProcessorMultiView::*shade_func32_)(unsigned, const uint32_t*);
+
+	// sets the vertex shader of a view, also for views added later
+	void (*view_shader_)(GeometryProcessor&);
+
+	const void *uniforms_;
+
+	// the outputs of the view independent part of the vertex shader
+	std::vector<VertexOutput> shared_;
+	std::vector<bool> shaded_;
+
+	// the vertices shaded by the current draw call, to reset shaded_
+	std::vector<unsigned> touched_;
+};
+
+} // end namespace swr
+
+#endif
@@ -59,21 +59,61 @@ public:
 			geometry_processors_[i].vertex_attrib_pointer(n, stride, buffer);
 	}
 
-	void draw_triangles(unsigned count, unsigned *indices)
+	void uniforms(const void *uniforms)
+	{
+		for (size_t i = 0; i < geometry_processors_.size(); ++i)
+			geometry_processors_[i].uniforms(uniforms);
+	}
+
+	void vertex_attrib_divisor(int n, unsigned divisor)
+	{
+		for (size_t i = 0; i < geometry_processors_.size(); ++i)
+			geometry_processors_[i].vertex_attrib_divisor(n, divisor);
+	}
+
+	// IndexType is uint16_t or uint32_t
+	template <typename IndexType>
+	void draw_triangles(unsigned count, const IndexType *indices)
 	{
 		#pragma omp parallel for num_threads(thread_count_)
 		for (int i = 0; i < (int) geometry_processors_.size(); ++i)
 			geometry_processors_[i].draw_triangles(count, indices);
 	}
 
-	void draw_lines(unsigned count, unsigned *indices)
+	template <typename IndexType>
+	void draw_triangles_instanced(unsigned count, const IndexType *indices, unsigned instance_count)
+	{
+		#pragma omp parallel for num_threads(thread_count_)
+		for (int i = 0; i < (int) geometry_processors_.size(); ++i)
+			geometry_processors_[i].draw_triangles_instanced(count, indices, instance_count);
+	}
+
+	template <typename IndexType>
+	void draw_triangle_strip(unsigned count, const IndexType *indices)
+	{
+		#pragma omp parallel for num_threads(thread_count_)
+		for (int i = 0; i < (int) geometry_processors_.size(); ++i)
+			geometry_processors_[i].draw_triangle_strip(count, indices);
+	}
+
+	template <typename IndexType>
+	void draw_triangle_fan(unsigned count, const IndexType *indices)
+	{
+		#pragma omp parallel for num_threads(thread_count_)
+		for (int i = 0; i < (int) geometry_processors_.size(); ++i)
+			geometry_processors_[i].draw_triangle_fan(count, indices);
+	}
+
+	template <typename IndexType>
+	void draw_lines(unsigned count, const IndexType *indices)
 	{
 		#pragma omp parallel for num_threads(thread_count_)
 		for (int i = 0; i < (int) geometry_processors_.size(); ++i)
 			geometry_processors_[i].draw_lines(count, indices);
 	}
 
-	void draw_points(unsigned count, unsigned *indices)
+	template <typename IndexType>
+	void draw_points(unsigned count, const IndexType *indices)
 	{
 		#pragma omp parallel for num_threads(thread_count_)
 		for (int i = 0; i < (int) geometry_processors_.size(); ++i)
@@ -86,6 +126,12 @@ public:
 			geometry_processors_[i].cull_mode(m);
 	}
 
+	void restart_index(unsigned index)
+	{
+		for (size_t i = 0; i < geometry_processors_.size(); ++i)
+			geometry_processors_[i].restart_index(index);
+	}
+
 	template<typename VertexShader>
 	void vertex_shader()
 	{
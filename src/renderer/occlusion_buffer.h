@@ -0,0 +1,223 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef OCCLUSION_BUFFER_H_
+#define OCCLUSION_BUFFER_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "geometry_processor.h"
+#include "rasterizer_subdivaffine.h"
+#include "depth_span.h"
+#include "framebuffer.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+namespace swr {
+
+	// Object level occlusion culling with a small depth buffer.
+	//
+	// Each frame the buffer is cleared, the occluders (walls, large objects)
+	// are drawn with geometry_processor() and update() is called. After that
+	// the bounds of other objects can be tested before they are drawn. An
+	// object which fails the test is hidden behind the occluders and its draw
+	// can be skipped completely.
+	//
+	//   occlusion.clear();
+	//   GeometryProcessor &gp = occlusion.geometry_processor();
+	//   gp.vertex_shader<OccluderShader>();    // writes only x, y, z, w
+	//   gp.vertex_attrib_pointer(0, stride, occluder_vertices);
+	//   gp.draw_triangles(count, occluder_indices);
+	//   occlusion.update();
+	//   ...
+	//   if (occlusion.test_bounds(box_corners, 8))
+	//       draw the object
+	//
+	// The occluders are drawn with the depth-only span drawer into a 16 bit
+	// depth buffer. update() stores the farthest depth of each 8x8 block, so
+	// most tests only look at a handful of blocks and only blocks which are
+	// not decided by that are tested per pixel.
+	//
+	// The test is conservative with respect to the bounds, but occluders are
+	// sampled at the pixel centers of the low resolution. So they should not
+	// be larger than the geometry they stand for.
+	//
+	// The object contains a GeometryProcessor and is therefore large. Better
+	// allocate it on the heap.
+	class OcclusionBuffer {
+	public:
+		static const int BLOCK_SIZE_LOG2 = 3;
+		static const int BLOCK_SIZE = 1 << BLOCK_SIZE_LOG2;
+
+		// The size should be a multiple of BLOCK_SIZE and the aspect ratio
+		// should be the one of the screen.
+		OcclusionBuffer(int width = 256, int height = 128) :
+			depth_(0, width, height, 0),
+			geometry_processor_(&rasterizer_),
+			blocks_x_((width + BLOCK_SIZE - 1) >> BLOCK_SIZE_LOG2),
+			blocks_y_((height + BLOCK_SIZE - 1) >> BLOCK_SIZE_LOG2),
+			block_max_(blocks_x_ * blocks_y_, 0xffff)
+		{
+			rasterizer_.clip_rect(0, 0, width, height);
+			rasterizer_.fragment_shader<OccluderSpan>();
+			rasterizer_.userdata(this);
+			geometry_processor_.viewport(0, 0, width, height);
+		}
+
+		int width() const { return depth_.width(); }
+		int height() const { return depth_.height(); }
+
+		// Used to draw the occluders. The viewport and the rasterizer are set
+		// up by the occlusion buffer and must not be changed. The default
+		// depth range of the GeometryProcessor is used.
+		GeometryProcessor& geometry_processor() { return geometry_processor_; }
+
+		// Removes all occluders.
+		void clear()
+		{
+			depth_.clear(0, 0xffff);
+			std::fill(block_max_.begin(), block_max_.end(), 0xffff);
+		}
+
+		// Must be called after drawing the occluders and before testing.
+		void update()
+		{
+			depth_.resolve();
+
+			for (int by = 0; by < blocks_y_; ++by) {
+				for (int bx = 0; bx < blocks_x_; ++bx) {
+					const int x0 = bx << BLOCK_SIZE_LOG2;
+					const int y0 = by << BLOCK_SIZE_LOG2;
+					const int x1 = (std::min)(x0 + BLOCK_SIZE, width());
+					const int y1 = (std::min)(y0 + BLOCK_SIZE, height());
+
+					uint16_t m = 0;
+					for (int y = y0; y < y1; ++y) {
+						const uint16_t *d = depth_.depth().pointer(x0, y);
+						for (int x = 0; x < x1 - x0; ++x)
+							m = (std::max)(m, d[x]);
+					}
+					block_max_[by * blocks_x_ + bx] = m;
+				}
+			}
+		}
+
+		// Tests the pixels from (x0, y0) up to but excluding (x1, y1) of the
+		// buffer. z is the nearest depth of the object in the range of
+		// IRasterizer::Vertex::z. Returns false if all of these pixels have
+		// an occluder in front of z, true if the object may be visible.
+		bool test_rect(int x0, int y0, int x1, int y1, int z) const
+		{
+			x0 = (std::max)(x0, 0);
+			y0 = (std::max)(y0, 0);
+			x1 = (std::min)(x1, width());
+			y1 = (std::min)(y1, height());
+			if (x0 >= x1 || y0 >= y1)
+				return false;
+
+			const uint16_t d = detail::depth16(z);
+
+			for (int by = y0 >> BLOCK_SIZE_LOG2; by <= (y1 - 1) >> BLOCK_SIZE_LOG2; ++by) {
+				for (int bx = x0 >> BLOCK_SIZE_LOG2; bx <= (x1 - 1) >> BLOCK_SIZE_LOG2; ++bx) {
+					// everything in this block is in front of the object
+					if (block_max_[by * blocks_x_ + bx] < d)
+						continue;
+
+					const int bx0 = (std::max)(x0, bx << BLOCK_SIZE_LOG2);
+					const int by0 = (std::max)(y0, by << BLOCK_SIZE_LOG2);
+					const int bx1 = (std::min)(x1, (bx + 1) << BLOCK_SIZE_LOG2);
+					const int by1 = (std::min)(y1, (by + 1) << BLOCK_SIZE_LOG2);
+
+					for (int y = by0; y < by1; ++y) {
+						const uint16_t *p = depth_.depth().pointer(bx0, y);
+						for (int x = 0; x < bx1 - bx0; ++x)
+							if (p[x] >= d)
+								return true;
+					}
+				}
+			}
+
+			return false;
+		}
+
+		// Tests the screen bounds of count points in clip space, for
+		// instance the eight corners of a bounding box transformed like the
+		// vertex shader does it. x, y, z and w are in 16.16 fixed point. If
+		// a point is behind the near plane the object counts as visible.
+		bool test_bounds(const int (*points)[4], unsigned count) const
+		{
+			if (!count)
+				return false;
+
+			// same transformation as in GeometryProcessor, in floating point
+			// to avoid overflows with points far outside of the view.
+			const double px = width() / 2, py = height() / 2;
+			const double n = 0, f = 0x3fffffff;
+
+			double minx = width(), miny = height(), maxx = 0, maxy = 0;
+			double minz = f;
+
+			for (unsigned i = 0; i < count; ++i) {
+				const double w = points[i][3];
+				if (points[i][2] < -points[i][3] || w <= 0)
+					return true;
+
+				const double x = px * points[i][0] / w + px;
+				const double y = py * -points[i][1] / w + py;
+				const double z = (f - n) / 2 * points[i][2] / w + (n + f) / 2;
+
+				minx = (std::min)(minx, x);
+				maxx = (std::max)(maxx, x);
+				miny = (std::min)(miny, y);
+				maxy = (std::max)(maxy, y);
+				minz = (std::min)(minz, z);
+			}
+
+			minx = (std::max)(minx, 0.0);
+			miny = (std::max)(miny, 0.0);
+			maxx = (std::min)(maxx, double(width()));
+			maxy = (std::min)(maxy, double(height()));
+			if (minx > maxx || miny > maxy)
+				return false;
+
+			return test_rect(
+				static_cast<int>(std::floor(minx)), static_cast<int>(std::floor(miny)),
+				static_cast<int>(std::floor(maxx)) + 1, static_cast<int>(std::floor(maxy)) + 1,
+				static_cast<int>((std::min)((std::max)(minz, 0.0), f)));
+		}
+
+		// the depth buffer of the occluders, valid after update()
+		const Framebuffer& depth() const { return depth_; }
+
+	private:
+		// not copyable
+		OcclusionBuffer(const OcclusionBuffer&);
+		OcclusionBuffer& operator=(const OcclusionBuffer&);
+
+		struct OccluderSpan;
+		friend struct OccluderSpan;
+
+		struct OccluderSpan : public SpanDrawerDepthOnly<OccluderSpan> {
+			static const unsigned varying_count = 0;
+			static const bool interpolate_z = true;
+
+			static Framebuffer& framebuffer(void *userdata)
+			{ return static_cast<OcclusionBuffer*>(userdata)->depth_; }
+		};
+
+		// depth only, no color plane
+		Framebuffer depth_;
+		RasterizerSubdivAffine rasterizer_;
+		GeometryProcessor geometry_processor_;
+
+		int blocks_x_, blocks_y_;
+		// farthest depth of each block
+		std::vector<uint16_t> block_max_;
+	};
+}
+
+#endif
@@ -0,0 +1,90 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef OCCLUSION_QUERY_H_
+#define OCCLUSION_QUERY_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "framebuffer.h"
+
+#include <vector>
+#include <cassert>
+
+namespace swr {
+
+	// Counts the pixels of the draws between begin() and end() which pass
+	// the depth test. The fragment shader returns the query from its
+	// occlusion_query(userdata) function and the span drawer adds to it.
+	//
+	// A typical use is conditional rendering: the bounding box of an object
+	// is drawn with depth test only (SpanDrawerDepthOnly<..., false>) and the
+	// object itself is drawn only if result() is not 0. The result stays
+	// valid until the next begin(), so it can also be used a frame later to
+	// avoid waiting for the current one.
+	//
+	// There is one counter per framebuffer tile, each on its own cache line.
+	// RasterizerParallel never lets two threads draw into the same tile, so
+	// its threads count without synchronization. end() adds the counters up
+	// and must be called after all draws of the query have returned.
+	class OcclusionQuery {
+	public:
+		static const int TILE_SIZE_LOG2 = Plane<uint16_t>::TILE_SIZE_LOG2;
+
+		// width and height of the framebuffer the query is used with
+		OcclusionQuery(int width, int height) :
+			tiles_x_((width + (1 << TILE_SIZE_LOG2) - 1) >> TILE_SIZE_LOG2),
+			counters_(tiles_x_ * ((height + (1 << TILE_SIZE_LOG2) - 1) >> TILE_SIZE_LOG2)),
+			result_(0),
+			active_(false)
+		{}
+
+		void begin()
+		{
+			assert(!active_);
+			for (size_t i = 0; i < counters_.size(); ++i)
+				counters_[i].count = 0;
+			active_ = true;
+		}
+
+		void end()
+		{
+			assert(active_);
+			result_ = 0;
+			for (size_t i = 0; i < counters_.size(); ++i)
+				result_ += counters_[i].count;
+			active_ = false;
+		}
+
+		bool active() const { return active_; }
+
+		// Number of pixels which passed the depth test between the last
+		// begin() and end().
+		unsigned result() const { return result_; }
+
+		// Called by the span drawers with count pixels of a span starting at
+		// (x, y) that passed. The span must not cross a tile boundary.
+		void add(int x, int y, unsigned count)
+		{
+			if (active_)
+				counters_[(y >> TILE_SIZE_LOG2) * tiles_x_ + (x >> TILE_SIZE_LOG2)].count += count;
+		}
+
+	private:
+		struct Counter {
+			unsigned count;
+			// keeps the counters of different tiles in different cache lines
+			char padding[64 - sizeof(unsigned)];
+
+			Counter() : count(0) {}
+		};
+
+		int tiles_x_;
+		std::vector<Counter> counters_;
+		unsigned result_;
+		bool active_;
+	};
+}
+
+#endif
@@ -0,0 +1,132 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef PIXEL_FORMAT_H_
+#define PIXEL_FORMAT_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <stdint.h>
+#include <algorithm>
+
+namespace swr {
+
+	// Pixel formats for textures. Each format defines the pixel_type used for
+	// storage and the filtering operations on it:
+	//
+	//   from_rgb(r, g, b)            conversion from 8 bit channels (opaque)
+	//   average(a, b, c, d)          box filter used for mipmap generation
+	//   bilinear(a, b, c, d, fx, fy) a and b are the upper, c and d the lower
+	//                                texels. fx and fy are 8 bit fractions.
+	//
+	// The 16 bit formats filter with weights from 0 to 32 and round after
+	// each of their two lerps. Their color channels are spread out into a 32
+	// bit integer with enough room between them so that all channels are
+	// filtered with one multiplication.
+
+	// 16 bit r5g6b5
+	struct RGB565 {
+		typedef uint16_t pixel_type;
+
+		static pixel_type from_rgb(unsigned r, unsigned g, unsigned b)
+		{ return static_cast<pixel_type>((r >> 3) << 11 | (g >> 2) << 5 | b >> 3); }
+
+		static uint32_t spread(pixel_type p)
+		{ return (p | (uint32_t(p) << 16)) & 0x07E0F81F; }
+
+		static pixel_type pack(uint32_t x)
+		{ x &= 0x07E0F81F; return static_cast<pixel_type>(x | (x >> 16)); }
+
+		static pixel_type average(pixel_type a, pixel_type b, pixel_type c, pixel_type d)
+		{
+			return pack((spread(a) + spread(b) + spread(c) + spread(d)) >> 2);
+		}
+
+		static pixel_type bilinear(pixel_type a, pixel_type b, pixel_type c, pixel_type d,
+			unsigned fx, unsigned fy)
+		{
+			// 5 bit weights from 0 to 32 and rounding in every channel
+			const uint32_t ROUND = 16 << 21 | 16 << 11 | 16;
+			fx = weight5(fx); fy = weight5(fy);
+			const uint32_t top = (spread(a) * (32 - fx) + spread(b) * fx + ROUND) >> 5 & 0x07E0F81F;
+			const uint32_t bottom = (spread(c) * (32 - fx) + spread(d) * fx + ROUND) >> 5 & 0x07E0F81F;
+			return pack((top * (32 - fy) + bottom * fy + ROUND) >> 5);
+		}
+
+		// maps an 8 bit fraction to 0..32
+		static unsigned weight5(unsigned f)
+		{ return (std::min)((f + 4) >> 3, 32u); }
+	};
+
+	// 16 bit r5g5a1b5. The alpha bit is meant for alpha testing and is not
+	// filtered. Bilinear filtering takes it from the nearest texel, averaging
+	// sets it if at least two of the four texels have it set.
+	struct R5G5A1B5 {
+		typedef uint16_t pixel_type;
+
+		static const pixel_type ALPHA_BIT = 0x20;
+
+		static pixel_type from_rgb(unsigned r, unsigned g, unsigned b)
+		{ return static_cast<pixel_type>((r >> 3) << 11 | (g >> 3) << 6 | ALPHA_BIT | b >> 3); }
+
+		static uint32_t spread(pixel_type p)
+		{ return (p | (uint32_t(p) << 16)) & 0x07C0F81F; }
+
+		static pixel_type pack(uint32_t x)
+		{ x &= 0x07C0F81F; return static_cast<pixel_type>(x | (x >> 16)); }
+
+		static pixel_type average(pixel_type a, pixel_type b, pixel_type c, pixel_type d)
+		{
+			const unsigned alpha = (a & ALPHA_BIT) + (b & ALPHA_BIT) + (c & ALPHA_BIT) + (d & ALPHA_BIT);
+			const pixel_type rgb = pack((spread(a) + spread(b) + spread(c) + spread(d)) >> 2);
+			return rgb | (alpha >= 2 * ALPHA_BIT ? ALPHA_BIT : 0);
+		}
+
+		static pixel_type bilinear(pixel_type a, pixel_type b, pixel_type c, pixel_type d,
+			unsigned fx, unsigned fy)
+		{
+			const pixel_type nearest = fy < 128 ? (fx < 128 ? a : b) : (fx < 128 ? c : d);
+
+			const uint32_t ROUND = 16 << 22 | 16 << 11 | 16;
+			fx = RGB565::weight5(fx); fy = RGB565::weight5(fy);
+			const uint32_t top = (spread(a) * (32 - fx) + spread(b) * fx + ROUND) >> 5 & 0x07C0F81F;
+			const uint32_t bottom = (spread(c) * (32 - fx) + spread(d) * fx + ROUND) >> 5 & 0x07C0F81F;
+			const pixel_type rgb = pack((top * (32 - fy) + bottom * fy + ROUND) >> 5);
+			return rgb | (nearest & ALPHA_BIT);
+		}
+	};
+
+	// 32 bit with 8 bits per channel. The channel order does not matter for
+	// filtering, so this works for RGBA and BGRA alike. Filters with 8 bit
+	// weights by processing two channels per multiplication. from_rgb puts
+	// red into the lowest byte (r, g, b, a in memory on little endian).
+	struct RGBA8888 {
+		typedef uint32_t pixel_type;
+
+		static pixel_type from_rgb(unsigned r, unsigned g, unsigned b)
+		{ return r | g << 8 | b << 16 | 0xff000000; }
+
+		static pixel_type average(pixel_type a, pixel_type b, pixel_type c, pixel_type d)
+		{
+			const uint32_t rb = ((a & 0x00ff00ff) + (b & 0x00ff00ff) + (c & 0x00ff00ff) + (d & 0x00ff00ff)) >> 2;
+			const uint32_t ga = ((a >> 8 & 0x00ff00ff) + (b >> 8 & 0x00ff00ff) + (c >> 8 & 0x00ff00ff) + (d >> 8 & 0x00ff00ff)) >> 2;
+			return (rb & 0x00ff00ff) | (ga & 0x00ff00ff) << 8;
+		}
+
+		static pixel_type lerp(pixel_type a, pixel_type b, unsigned f)
+		{
+			const uint32_t rb = ((a & 0x00ff00ff) * (256 - f) + (b & 0x00ff00ff) * f) >> 8;
+			const uint32_t ga = ((a >> 8 & 0x00ff00ff) * (256 - f) + (b >> 8 & 0x00ff00ff) * f) >> 8;
+			return (rb & 0x00ff00ff) | (ga & 0x00ff00ff) << 8;
+		}
+
+		static pixel_type bilinear(pixel_type a, pixel_type b, pixel_type c, pixel_type d,
+			unsigned fx, unsigned fy)
+		{
+			return lerp(lerp(a, b, fx), lerp(c, d, fx), fy);
+		}
+	};
+}
+
+#endif
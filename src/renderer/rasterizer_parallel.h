@@ -8,6 +8,7 @@
 #endif
 
 #include <vector>
+#include <algorithm>
 #include "irasterizer.h"
 
 namespace swr {
@@ -20,9 +21,21 @@ private:
 	int cols_;
 	int thread_count_;
 
+	// see clip_rect
+	static const int REGION_ALIGNMENT = 64;
+
+	// the border before region i of count regions of [start, start + size)
+	static int region_border(int start, int size, int i, int count)
+	{
+		if (i == 0) return start;
+		if (i == count) return start + size;
+		const int border = (start + size * i / count + REGION_ALIGNMENT - 1) & ~(REGION_ALIGNMENT - 1);
+		return (std::min)(border, start + size);
+	}
+
 public:
 	RasterizerParallel(int rows, int cols, int thread_count = 4) :
-			rows_(rows), cols_(cols), rasterizers_(rows * cols), thread_count_(thread_count)
+			rasterizers_(rows * cols), rows_(rows), cols_(cols), thread_count_(thread_count)
 	{
 		perspective_correction(true);
 		perspective_threshold(0, 0);
@@ -48,25 +61,40 @@ public:
 			rasterizers_[i].perspective_threshold(w, h);
 	}
 
+	void perspective_error(int error)
+	{
+		for (size_t i = 0; i < rasterizers_.size(); ++i)
+			rasterizers_[i].perspective_error(error);
+	}
+
+	void perspective_subdivision(int min_log2, int max_log2)
+	{
+		for (size_t i = 0; i < rasterizers_.size(); ++i)
+			rasterizers_[i].perspective_subdivision(min_log2, max_log2);
+	}
+
 	template<typename FragSpan>
 	void fragment_shader()
 	{
 		for (size_t i = 0; i < rasterizers_.size(); ++i)
-			rasterizers_[i].fragment_shader<FragSpan>();
+			rasterizers_[i].template fragment_shader<FragSpan>();
 	}
 
+	// Splits the clipping rectangle into the regions of the sub rasterizers.
+	// The borders between the regions are aligned to REGION_ALIGNMENT pixels,
+	// the tile size of BasicFramebuffer, so that no two threads ever draw
+	// into the same framebuffer tile.
 	void clip_rect(int x, int y, int w, int h)
 	{
-		int woffset = w / cols_;
-		int hoffset = h / rows_;
-
 		for (int r = 0; r < rows_; ++r) {
+			const int y0 = region_border(y, h, r, rows_);
+			const int y1 = region_border(y, h, r + 1, rows_);
+
 			for (int c = 0; c < cols_; ++c) {
-				int index = r * cols_ + c;
-				int clipwidth = c == cols_ - 1 ? w - c * woffset : woffset;
-				int clipheight = r == cols_ - 1 ? h - r * hoffset : hoffset;
-				rasterizers_[index].clip_rect(x + woffset * c, y + hoffset * r, clipwidth,
-						clipheight);
+				const int x0 = region_border(x, w, c, cols_);
+				const int x1 = region_border(x, w, c + 1, cols_);
+
+				rasterizers_[r * cols_ + c].clip_rect(x0, y0, x1 - x0, y1 - y0);
 			}
 		}
 	}
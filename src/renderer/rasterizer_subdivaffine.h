@@ -45,6 +45,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <cmath>
 #include <algorithm>
+#include <stdint.h>
 
 namespace swr {
 
@@ -53,9 +54,11 @@ public:
 	// constructor
 	RasterizerSubdivAffine() :
 		triangle_func_(0),
-		perspective_correction_(true)
+		perspective_correction_(true),
+		perspective_error_(8)
 	{
 		perspective_threshold(0, 0);
+		perspective_subdivision(3, 6);
 	}
 
 public:
@@ -70,6 +73,23 @@ public:
 		perspective_threshold_.h = h;
 	}
 
+	// The error in 1/16 pixels (like the 28.4 vertex positions) which affine
+	// interpolation may have. Triangles whose w changes so little that the
+	// error stays below this are drawn without perspective correction, no
+	// matter how large they are. 0 corrects every triangle larger than the
+	// perspective_threshold. The default is half a pixel.
+	void perspective_error(int error)
+	{ perspective_error_ = error; }
+
+	// Perspective correct spans are divided into affine pieces of 2^min_log2
+	// to 2^max_log2 pixels. The length is chosen per triangle: the longest
+	// piece which stays within the perspective_error.
+	void perspective_subdivision(int min_log2, int max_log2)
+	{
+		subdivision_.min_log2 = min_log2;
+		subdivision_.max_log2 = (std::max)(min_log2, max_log2);
+	}
+
 	// set the fragment shader
 	template <typename FragSpan>
 	void fragment_shader()
@@ -95,6 +115,13 @@ private:
 		int h;
 	} perspective_threshold_;
 
+	int perspective_error_;
+
+	struct {
+		int min_log2;
+		int max_log2;
+	} subdivision_;
+
 	// The triangle must be counter clockwise in screen space in order to be
 	// drawn.
 	template <typename FragSpan>
@@ -184,9 +211,22 @@ private:
 			}
 		}
 
-		if (perspective_correction_ && (
+		// without varyings there is nothing to correct, z is affine anyway
+		bool perspective = perspective_correction_ && FragSpan::varying_count && (
 			(maxx - minx) > perspective_threshold_.w || 
-			(maxy - miny) > perspective_threshold_.h ))
+			(maxy - miny) > perspective_threshold_.h );
+
+		// Affine interpolation displaces the values by about
+		// (wmax / wmin - 1) / 4 times the size of the triangle. Nearly screen
+		// parallel triangles don't need the correction even when large.
+		const int wmin = (std::min)((std::min)(v1.w, v2.w), v3.w);
+		const int wmax = (std::max)((std::max)(v1.w, v2.w), v3.w);
+		if (perspective && wmin > 0) {
+			const int extent = (std::max)(maxx - minx, maxy - miny);
+			perspective = int64_t(wmax - wmin) * extent * 4 > int64_t(wmin) * perspective_error_;
+		}
+
+		if (perspective)
 		{
 			// computes the gradients of the varyings to be used for stepping
 			struct Gradients {
@@ -300,6 +340,16 @@ private:
 			};
 
 			Gradients grad(v1, v2, v3, DX12, DY12, DX31, DY31, inv_area);
+
+			// Along an affine piece of L pixels the error is about
+			// |d(1/w)/dx| * L^2 / (4 * min(1/w)) pixels.
+			const int64_t oow_min = invert(wmax);
+			const int64_t doow = grad.dx.oow < 0 ? -int64_t(grad.dx.oow) : int64_t(grad.dx.oow);
+			int subdiv = subdivision_.max_log2;
+			while (subdiv > subdivision_.min_log2 && 
+				(doow << (2 * subdiv)) * 4 > oow_min * perspective_error_)
+				--subdiv;
+
 			Edge top_middle(grad, top, middle);
 			Edge top_bottom(grad, top, bottom);
 			Edge middle_bottom(grad, middle, bottom);
@@ -315,7 +365,8 @@ private:
 			}
 
 			struct Scanline {
-				static void draw(const Edge *left, const Edge *right, int cl, int cr, void *userdata)
+				static void draw(const Edge *left, const Edge *right, int cl, int cr, int subdiv,
+					void *userdata)
 				{
 					int y = left->y;
 					int l = left->x;
@@ -336,7 +387,7 @@ private:
 						l = cl;
 					}
 
-					FragSpan::perspective_span(l, y, fdp, grad.dx, r - l, userdata);
+					FragSpan::perspective_span_subdiv(l, y, fdp, grad.dx, r - l, subdiv, userdata);
 				}
 			};
 
@@ -346,7 +397,7 @@ private:
 			while (height) {
 				int y = left->y;
 				if (ilace_drawit(y) && y >= clip_rect_.y0 && y < clip_rect_.y1) 
-					Scanline::draw(left, right, clip_rect_.x0, clip_rect_.x1, userdata_);
+					Scanline::draw(left, right, clip_rect_.x0, clip_rect_.x1, subdiv, userdata_);
 				left->step(true);
 				right->step(false);
 				height--;
@@ -365,7 +416,7 @@ private:
 			while (height) {
 				int y = left->y;
 				if (ilace_drawit(y) && y >= clip_rect_.y0 && y < clip_rect_.y1) 
-					Scanline::draw(left, right, clip_rect_.x0, clip_rect_.x1, userdata_);
+					Scanline::draw(left, right, clip_rect_.x0, clip_rect_.x1, subdiv, userdata_);
 				left->step(true);
 				right->step(false);
 				height--;
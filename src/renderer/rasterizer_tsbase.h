@@ -63,7 +63,9 @@ namespace swr {
 		void *userdata_;
 
 	public:
-		RasterizerTemplateShaderBase()
+		RasterizerTemplateShaderBase() :
+			line_func_(0),
+			point_func_(0)
 		{
 			clip_rect(0, 0, 0, 0);
 			interlace(0, 0);
@@ -42,29 +42,33 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "duffsdevice.h"
 #include "fixed_func.h"
 #include "util.h"
+#include "framebuffer.h"
 
 #include "stepmacros.h"
 #include <vector>
 #include <limits>
+#include <cassert>
 
 namespace swr {
 
+	class OcclusionQuery;
+
 	template <typename FragmentShader>
 	struct SpanDrawerBase {
-		static const int AFFINE_LENGTH = 24;
-
-		static IRasterizer::FragmentData compute_step_al(
+		// step for a span of 1 << length_log2 pixels
+		static IRasterizer::FragmentData compute_step_shift(
 			const IRasterizer::FragmentData &fdl, 
-			const IRasterizer::FragmentData &fdr)
+			const IRasterizer::FragmentData &fdr,
+			int length_log2)
 		{
 			IRasterizer::FragmentData r;
 
 			if (FragmentShader::interpolate_z)
-				r.z = (fdr.z - fdl.z) / AFFINE_LENGTH;
+				r.z = (fdr.z - fdl.z) >> length_log2;
 
 			DUFFS_DEVICE8(
 				int i = 0,
-				r.varyings[i] = (fdr.varyings[i] - fdl.varyings[i]) / AFFINE_LENGTH; ++i,
+				r.varyings[i] = (fdr.varyings[i] - fdl.varyings[i]) >> length_log2; ++i,
 				FragmentShader::varying_count,
 				/**/)
 
@@ -114,32 +118,39 @@ namespace swr {
 			return r;
 		}
 
-		static void perspective_span(
+		// Draws a perspective correct span as affine pieces of 1 << length_log2
+		// pixels. The perspective correct values are only computed at the ends
+		// of the pieces. RasterizerSubdivAffine chooses the length per triangle
+		// from how much w changes along the spans.
+		static void perspective_span_subdiv(
 			int x, 
 			int y, 
 			const IRasterizer::FragmentDataPerspective &fd_in, 
 			const IRasterizer::FragmentDataPerspective &step, 
 			unsigned n,
+			int length_log2,
 			void *userdata)
 		{
 			using namespace detail;
 
+			const int length = 1 << length_log2;
+
 			IRasterizer::FragmentDataPerspective fds[2];
 			FRAGMENTDATA_PERSPECTIVE_APPLY(FragmentShader, fds[0], = , fd_in);
 
 			IRasterizer::FragmentData fd[2];
 			fd[0] = fd_from_fds(fds[0]);
 
-			while (AFFINE_LENGTH <= static_cast<int>(n)) {
+			while (length <= static_cast<int>(n)) {
 				FRAGMENTDATA_PERSPECTIVE_APPLY(FragmentShader, fds[1], = , fds[0]);
-				FRAGMENTDATA_PERSPECTIVE_APPLY(FragmentShader, fds[1], += AFFINE_LENGTH *, step);
+				FRAGMENTDATA_PERSPECTIVE_APPLY(FragmentShader, fds[1], += length *, step);
 
 				fd[1] = fd_from_fds(fds[1]);
 
-				const IRasterizer::FragmentData step = compute_step_al(fd[0], fd[1]);
+				const IRasterizer::FragmentData step = compute_step_shift(fd[0], fd[1], length_log2);
 
-				FragmentShader::affine_span(x, y, fd[0], step, AFFINE_LENGTH, userdata);
-				x += AFFINE_LENGTH; n -= AFFINE_LENGTH;
+				FragmentShader::affine_span(x, y, fd[0], step, length, userdata);
+				x += length; n -= length;
 
 				FRAGMENTDATA_PERSPECTIVE_APPLY(FragmentShader, fds[0], =, fds[1]);
 				FRAGMENTDATA_APPLY(FragmentShader, fd[0], =, fd[1]);
@@ -160,8 +171,8 @@ namespace swr {
 		}
 
 		// Per triangle callback. This could for instance be used to select the
-		// mipmap level of detail. Empty function defined here, so that it it optional for the
-		// fragment shader.
+		// mipmap level of detail (see Texture::select_level). Empty function 
+		// defined here, so that it it optional for the fragment shader.
 		static void begin_triangle(
 			const IRasterizer::Vertex& v1,
 			const IRasterizer::Vertex& v2,
@@ -178,6 +189,12 @@ namespace swr {
 			void *userdata)
 		{}
 
+		// Returns the occlusion query which counts the pixels passing the
+		// depth test or 0 if there is none. Only span drawers which do the
+		// depth test themselves (SpanDrawerDepthOnly) use it.
+		static OcclusionQuery* occlusion_query(void *userdata)
+		{ return 0; }
+
 		// Line callback
 		static void begin_line(
 			const IRasterizer::Vertex &v1,
@@ -242,6 +259,92 @@ namespace swr {
 		}
 	};
 
+	// Same as SpanDrawer16BitColorAndDepth but draws into a BasicFramebuffer
+	// which the fragment shader returns from a static framebuffer(userdata)
+	// function. The color and depth references passed to single_fragment
+	// have the types of the framebuffer planes. Rows of the framebuffer that
+	// are still cleared are filled before the fragment shader sees them. 
+	// Without a depth plane the depth reference is a dummy holding the clear
+	// depth for every fragment. The framebuffer needs a color plane, use
+	// SpanDrawerDepthOnly for depth only framebuffers like shadow maps.
+	// Works with the linear and the tiled framebuffer layout.
+	template <typename FragmentShader>
+	struct SpanDrawerFramebuffer : public SpanDrawerBase<FragmentShader> {
+		static void affine_span(
+			int x, 
+			int y, 
+			IRasterizer::FragmentData fd, 
+			const IRasterizer::FragmentData &step, 
+			unsigned n,
+			void *userdata)
+		{
+			draw_span(FragmentShader::framebuffer(userdata), x, y, fd, step, n, userdata);
+		}
+
+		template <typename ColorType, typename DepthType>
+		static void draw_span(
+			BasicFramebuffer<ColorType, DepthType> &fb,
+			int x, 
+			int y, 
+			IRasterizer::FragmentData fd, 
+			const IRasterizer::FragmentData &step, 
+			unsigned n,
+			void *userdata)
+		{
+			typedef BasicFramebuffer<ColorType, DepthType> FramebufferType;
+
+			// spans clipped away completely can arrive with a negative count
+			if (static_cast<int>(n) <= 0)
+				return;
+
+			assert(fb.has_color());
+
+			fb.touch(x, y, n);
+
+			// the span is drawn in pieces that do not cross tile boundaries, 
+			// which are contiguous in memory in all framebuffer layouts.
+			while (n) {
+				const unsigned tile_end = (x | (FramebufferType::TILE_SIZE - 1)) + 1;
+				const unsigned count = (std::min)(n, tile_end - x);
+
+				ColorType *color_pointer = fb.color_pointer(x, y);
+
+				if (fb.has_depth()) {
+					DepthType *depth_pointer = fb.depth_pointer(x, y);
+
+					DUFFS_DEVICE16(
+						/**/,
+						{
+							FragmentShader::single_fragment(fd, *color_pointer, *depth_pointer, userdata);
+							FRAGMENTDATA_APPLY(FragmentShader, fd, += , step);
+
+							color_pointer++;
+							depth_pointer++;
+						},
+						count,
+						/**/)
+				} else {
+					DepthType depth;
+
+					DUFFS_DEVICE16(
+						/**/,
+						{
+							depth = fb.clear_depth();
+							FragmentShader::single_fragment(fd, *color_pointer, depth, userdata);
+							FRAGMENTDATA_APPLY(FragmentShader, fd, += , step);
+
+							color_pointer++;
+						},
+						count,
+						/**/)
+				}
+
+				x += count;
+				n -= count;
+			}
+		}
+	};
+
 	template <typename FragmentShader, int SampleCount>
 	struct SpanDrawerMultisampling: public SpanDrawerBase<FragmentShader> {
 		struct SampleData {
@@ -0,0 +1,339 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef TEXTURE_H_
+#define TEXTURE_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "irasterizer.h"
+#include "pixel_format.h"
+#include "bilinear_span.h"
+#include "util.h"
+
+#include <vector>
+#include <cstddef>
+#include <cassert>
+
+namespace swr {
+
+	// Texture memory layouts. offset() returns the position of texel (x, y)
+	// in a level of size (1 << width_log2) * (1 << height_log2) and size()
+	// the number of texels that need to be allocated for such a level.
+	//
+	// Row-major layouts are fine as long as textures are walked along their
+	// rows. When a texture is rotated on screen a span walks through it
+	// vertically or diagonally and each step lands in another cache line.
+	// The tiled and Morton layouts keep texels which are close in 2D also
+	// close in memory, so sampling costs about the same in every direction.
+
+	// row by row
+	struct LinearLayout {
+		static size_t size(int width_log2, int height_log2)
+		{ return size_t(1) << (width_log2 + height_log2); }
+
+		static size_t offset(unsigned x, unsigned y, int width_log2, int /*height_log2*/)
+		{ return (y << width_log2) + x; }
+	};
+
+	// square tiles of TileSize * TileSize texels stored row by row, with
+	// the tiles themselves also stored row by row. TileSize must be a power
+	// of two. Levels smaller than a tile are padded to a whole tile.
+	template <unsigned TileSize>
+	struct TiledLayout {
+		static const int TILE_LOG2 = detail::static_log2<TileSize>::value;
+		static const unsigned TILE_MASK = TileSize - 1;
+
+		static size_t size(int width_log2, int height_log2)
+		{
+			return size_t(1) << ((width_log2 > TILE_LOG2 ? width_log2 : TILE_LOG2) + 
+				(height_log2 > TILE_LOG2 ? height_log2 : TILE_LOG2));
+		}
+
+		static size_t offset(unsigned x, unsigned y, int width_log2, int /*height_log2*/)
+		{
+			const int tiles_per_row_log2 = width_log2 > TILE_LOG2 ? width_log2 - TILE_LOG2 : 0;
+			const size_t tile = ((y >> TILE_LOG2) << tiles_per_row_log2) + (x >> TILE_LOG2);
+			return (tile << (2 * TILE_LOG2)) + ((y & TILE_MASK) << TILE_LOG2) + (x & TILE_MASK);
+		}
+	};
+
+	// Z-order curve: the bits of x and y are interleaved. For non square
+	// levels the remaining high bits of the longer side are put on top.
+	struct MortonLayout {
+		static size_t size(int width_log2, int height_log2)
+		{ return size_t(1) << (width_log2 + height_log2); }
+
+		// spreads the lower 16 bits of v to the even bits
+		static uint32_t part1by1(uint32_t v)
+		{
+			v &= 0x0000ffff;
+			v = (v | (v << 8)) & 0x00ff00ff;
+			v = (v | (v << 4)) & 0x0f0f0f0f;
+			v = (v | (v << 2)) & 0x33333333;
+			v = (v | (v << 1)) & 0x55555555;
+			return v;
+		}
+
+		static size_t offset(unsigned x, unsigned y, int width_log2, int height_log2)
+		{
+			if (width_log2 == height_log2)
+				return part1by1(x) | (part1by1(y) << 1);
+
+			if (width_log2 > height_log2) {
+				const unsigned mask = (1u << height_log2) - 1;
+				return (part1by1(x & mask) | (part1by1(y) << 1)) + 
+					(size_t(x >> height_log2) << (2 * height_log2));
+			} else {
+				const unsigned mask = (1u << width_log2) - 1;
+				return (part1by1(x) | (part1by1(y & mask) << 1)) + 
+					(size_t(y >> width_log2) << (2 * width_log2));
+			}
+		}
+	};
+
+	namespace detail {
+		// mipmap level selection for Texture::select_level. The level is
+		// chosen so that one texel covers about one pixel: log2 of the ratio of
+		// the triangle's area in texture space (in texels of level 0) to its
+		// area on screen (in pixels), divided by two.
+		inline int select_level(
+			const IRasterizer::Vertex &v1,
+			const IRasterizer::Vertex &v2,
+			const IRasterizer::Vertex &v3,
+			int area2,
+			int u_index, int v_index,
+			int width_log2, int height_log2, int level_count)
+		{
+			if (level_count <= 1 || area2 <= 0)
+				return 0;
+
+			const int64_t du2 = v2.varyings[u_index] - v1.varyings[u_index];
+			const int64_t dv2 = v2.varyings[v_index] - v1.varyings[v_index];
+			const int64_t du3 = v3.varyings[u_index] - v1.varyings[u_index];
+			const int64_t dv3 = v3.varyings[v_index] - v1.varyings[v_index];
+
+			int64_t uv_area2 = du2 * dv3 - du3 * dv2;
+			if (uv_area2 < 0) uv_area2 = -uv_area2;
+			if (uv_area2 == 0)
+				return 0;
+
+			// uv_area2 has 32 fractional bits and area2 (28.4 squared) has 8.
+			// scaling to texels adds the log2 of the level 0 dimensions.
+			const int lod2 = log2_floor(uint64_t(uv_area2)) - log2_floor(uint64_t(area2)) +
+				width_log2 + height_log2 - 24;
+
+			int level = (lod2 + 1) >> 1;
+			if (level < 0) level = 0;
+			if (level >= level_count) level = level_count - 1;
+			return level;
+		}
+
+		// normalized 16.16 texture coordinate to texels in 24.8
+		inline int to_texel8(int coord, int size_log2)
+		{
+			return size_log2 >= 8 ? coord << (size_log2 - 8) : coord >> (8 - size_log2);
+		}
+	}
+
+	// A texture with power of two dimensions and an optional mipmap chain.
+	// PixelFormat is one of the formats in pixel_format.h and Layout one of
+	// the memory layouts above.
+	//
+	// Texture coordinates are normalized 16.16 fixed point values, so 1 << 16
+	// corresponds to the width or height of the texture. This way the same
+	// coordinates work for all mipmap levels. Coordinates outside [0, 1) wrap
+	// around. |u| * width and |v| * height must stay below 1 << 23.
+	template <typename PixelFormat, typename Layout = LinearLayout>
+	class Texture {
+	public:
+		typedef typename PixelFormat::pixel_type pixel_type;
+
+		static const int MAX_LEVELS = 16;
+
+		Texture() : level_count_(0) {}
+
+		// Creates the texture from row-major pixel data. width and height must
+		// be powers of two, pitch is given in pixels. With mipmaps set all
+		// levels down to 1x1 are generated.
+		Texture(unsigned width, unsigned height, const pixel_type *pixels,
+			unsigned pitch, bool mipmaps = true) : level_count_(0)
+		{
+			create(width, height, pixels, pitch, mipmaps);
+		}
+
+		void create(unsigned width, unsigned height, const pixel_type *pixels,
+			unsigned pitch, bool mipmaps = true)
+		{
+			assert(width && !(width & (width - 1)));
+			assert(height && !(height & (height - 1)));
+
+			// set up the level descriptions and the total size
+			size_t size = 0;
+			level_count_ = 0;
+			for (;;) {
+				Level &l = levels_[level_count_++];
+				l.width = width;
+				l.height = height;
+				l.width_log2 = detail::log2_floor(width);
+				l.height_log2 = detail::log2_floor(height);
+				l.offset = size;
+				size += Layout::size(l.width_log2, l.height_log2);
+
+				if (!mipmaps || (width == 1 && height == 1) || level_count_ == MAX_LEVELS)
+					break;
+
+				if (width > 1) width >>= 1;
+				if (height > 1) height >>= 1;
+			}
+
+			data_.resize(size);
+
+			const Level &base = levels_[0];
+			for (unsigned y = 0; y < base.height; ++y)
+				for (unsigned x = 0; x < base.width; ++x)
+					data_[address(base, x, y)] = pixels[y * pitch + x];
+
+			for (int i = 1; i < level_count_; ++i)
+				downsample(levels_[i - 1], levels_[i]);
+		}
+
+		int level_count() const
+		{ return level_count_; }
+
+		unsigned width(int level = 0) const
+		{ return levels_[level].width; }
+
+		unsigned height(int level = 0) const
+		{ return levels_[level].height; }
+
+		// pixel data of a level in the memory layout of the texture
+		const pixel_type *level_data(int level) const
+		{ return &data_[levels_[level].offset]; }
+
+		// the texel at (x, y) in a level
+		pixel_type texel(unsigned x, unsigned y, int level = 0) const
+		{ return data_[address(levels_[level], x, y)]; }
+
+		// Computes the mipmap level for a whole triangle. Call this from the
+		// begin_triangle callback of the fragment shader with its arguments.
+		// u_index and v_index are the varyings with the texture coordinates.
+		int select_level(
+			const IRasterizer::Vertex &v1,
+			const IRasterizer::Vertex &v2,
+			const IRasterizer::Vertex &v3,
+			int area2,
+			int u_index, int v_index) const
+		{
+			return detail::select_level(v1, v2, v3, area2, u_index, v_index,
+				levels_[0].width_log2, levels_[0].height_log2, level_count_);
+		}
+
+		// Returns the texel that contains the texture coordinate.
+		pixel_type sample_nearest(int u, int v, int level = 0) const
+		{
+			const Level &l = levels_[level];
+			const unsigned x = static_cast<unsigned>(u >> (16 - l.width_log2)) & (l.width - 1);
+			const unsigned y = static_cast<unsigned>(v >> (16 - l.height_log2)) & (l.height - 1);
+			return data_[address(l, x, y)];
+		}
+
+		// Filters the four texels around the texture coordinate. Texel centers
+		// are at half texel offsets like in OpenGL.
+		pixel_type sample_bilinear(int u, int v, int level = 0) const
+		{
+			const Level &l = levels_[level];
+
+			// texel coordinates in 24.8
+			const int tu = detail::to_texel8(u, l.width_log2) - 128;
+			const int tv = detail::to_texel8(v, l.height_log2) - 128;
+
+			const unsigned x0 = static_cast<unsigned>(tu >> 8) & (l.width - 1);
+			const unsigned y0 = static_cast<unsigned>(tv >> 8) & (l.height - 1);
+			const unsigned x1 = (x0 + 1) & (l.width - 1);
+			const unsigned y1 = (y0 + 1) & (l.height - 1);
+
+			return PixelFormat::bilinear(
+				data_[address(l, x0, y0)], data_[address(l, x1, y0)],
+				data_[address(l, x0, y1)], data_[address(l, x1, y1)],
+				tu & 0xff, tv & 0xff);
+		}
+
+		// Bilinear filtering of n pixels along a span, starting at (u, v) and
+		// advancing by (du, dv) per pixel. The texels are gathered in batches
+		// which are then filtered together. For RGB565 and RGBA8888 this uses
+		// SSE2 or NEON when available (see bilinear_span.h).
+		void sample_bilinear_span(int u, int v, int du, int dv, unsigned n, 
+			pixel_type *out, int level = 0) const
+		{
+			typedef detail::BilinearBatch<pixel_type> Batch;
+
+			const Level &l = levels_[level];
+			Batch batch;
+
+			while (n) {
+				const unsigned count = n < Batch::BATCH_SIZE ? n : Batch::BATCH_SIZE;
+
+				for (unsigned i = 0; i < count; ++i) {
+					const int tu = detail::to_texel8(u, l.width_log2) - 128;
+					const int tv = detail::to_texel8(v, l.height_log2) - 128;
+
+					const unsigned x0 = static_cast<unsigned>(tu >> 8) & (l.width - 1);
+					const unsigned y0 = static_cast<unsigned>(tv >> 8) & (l.height - 1);
+					const unsigned x1 = (x0 + 1) & (l.width - 1);
+					const unsigned y1 = (y0 + 1) & (l.height - 1);
+
+					batch.a[i] = data_[address(l, x0, y0)];
+					batch.b[i] = data_[address(l, x1, y0)];
+					batch.c[i] = data_[address(l, x0, y1)];
+					batch.d[i] = data_[address(l, x1, y1)];
+					batch.fx[i] = static_cast<uint16_t>(tu & 0xff);
+					batch.fy[i] = static_cast<uint16_t>(tv & 0xff);
+
+					u += du;
+					v += dv;
+				}
+
+				detail::BilinearSpan<PixelFormat>::filter(batch, count, out);
+				out += count;
+				n -= count;
+			}
+		}
+
+	private:
+		struct Level {
+			unsigned width, height;
+			int width_log2, height_log2;
+			size_t offset;
+		};
+
+		static size_t address(const Level &l, unsigned x, unsigned y)
+		{
+			return l.offset + Layout::offset(x, y, l.width_log2, l.height_log2);
+		}
+
+		void downsample(const Level &src, const Level &dst)
+		{
+			// one of the dimensions may already be 1
+			const unsigned sx = src.width > dst.width ? 2 : 1;
+			const unsigned sy = src.height > dst.height ? 2 : 1;
+
+			for (unsigned y = 0; y < dst.height; ++y) {
+				const unsigned y0 = y * sy, y1 = y * sy + sy - 1;
+				for (unsigned x = 0; x < dst.width; ++x) {
+					const unsigned x0 = x * sx, x1 = x * sx + sx - 1;
+					data_[address(dst, x, y)] = PixelFormat::average(
+						data_[address(src, x0, y0)], data_[address(src, x1, y0)],
+						data_[address(src, x0, y1)], data_[address(src, x1, y1)]);
+				}
+			}
+		}
+
+		Level levels_[MAX_LEVELS];
+		int level_count_;
+		std::vector<pixel_type> data_;
+	};
+}
+
+#endif
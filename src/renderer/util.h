@@ -144,6 +144,31 @@ namespace swr {
 		#endif
 		}
 
+		// log2 of a power of two at compile time
+		template <unsigned N>
+		struct static_log2 {
+			static const int value = static_log2<N / 2>::value + 1;
+		};
+
+		template <>
+		struct static_log2<1> {
+			static const int value = 0;
+		};
+
+		// integer logarithm to the base 2 rounded down. returns -1 for 0.
+		inline int log2_floor(uint64_t value)
+		{
+			int r = -1;
+			if (value >> 32) { value >>= 32; r += 32; }
+			uint32_t v = static_cast<uint32_t>(value);
+			if (v >> 16) { v >>= 16; r += 16; }
+			if (v >> 8) { v >>= 8; r += 8; }
+			if (v >> 4) { v >>= 4; r += 4; }
+			if (v >> 2) { v >>= 2; r += 2; }
+			if (v >> 1) { v >>= 1; r += 1; }
+			return r + static_cast<int>(v);
+		}
+
 		// this can be used to invert a fixed point number of any precision.
 		// if input is a 28.4 number output is 4.28.
 		inline int invert(int value)
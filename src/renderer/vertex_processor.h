@@ -40,9 +40,45 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cassert>
 #include <algorithm>
 #include <vector>
+#include <stdint.h>
 
 namespace swr {
 
+namespace detail {
+	// true if T has a nested type uniform_type
+	template <typename T>
+	struct has_uniform_type {
+		typedef char yes;
+		typedef char (&no)[2];
+
+		template <typename U> static yes test(typename U::uniform_type*);
+		template <typename U> static no test(...);
+
+		static const bool value = sizeof(test<T>(0)) == sizeof(yes);
+	};
+
+	// Calls VertexShader::shade(in, out) or, if the vertex shader declares a
+	// uniform_type, VertexShader::shade(in, out, uniforms) with the uniforms
+	// as a reference of that type.
+	template <typename VertexShader, bool HasUniforms = has_uniform_type<VertexShader>::value>
+	struct ShadeCall {
+		template <typename VertexInput, typename VertexOutput>
+		static void shade(const VertexInput &in, VertexOutput &out, const void *)
+		{ VertexShader::shade(in, out); }
+	};
+
+	template <typename VertexShader>
+	struct ShadeCall<VertexShader, true> {
+		template <typename VertexInput, typename VertexOutput>
+		static void shade(const VertexInput &in, VertexOutput &out, const void *uniforms)
+		{
+			assert(uniforms);
+			VertexShader::shade(in, out, 
+				*static_cast<const typename VertexShader::uniform_type*>(uniforms));
+		}
+	};
+}
+
 // This class processes vertices and outputs vertices of the type VertexType
 // which can be specified as a template parameter. Internally it has a vertex
 // cache to detect duplicate vertices. For these vertices the stored result
@@ -54,14 +90,29 @@ public:
 	typedef VertexType VertexOutput;
 	typedef const void *VertexInput[MAX_ATTRIBUTES];
 
-	VertexProcessor() : process_func_(0) {}
+	// How the indices are assembled to triangles. Lines and points always
+	// use TOPOLOGY_LIST.
+	enum Topology {
+		TOPOLOGY_LIST,
+		TOPOLOGY_STRIP,
+		TOPOLOGY_FAN
+	};
+
+	VertexProcessor() : 
+		uniforms_(0),
+		process_func16_(0), 
+		process_func32_(0), 
+		restart_index_(static_cast<unsigned>(-1)) 
+	{}
 
 	// Set the vertex shader
 	template <typename VertexShader>
 	void vertex_shader()
 	{
-		process_func_ = &VertexProcessor<VertexType, Derived>::
-			template process_template<VertexShader>;
+		process_func16_ = &VertexProcessor<VertexType, Derived>::
+			template process_template<VertexShader, uint16_t>;
+		process_func32_ = &VertexProcessor<VertexType, Derived>::
+			template process_template<VertexShader, uint32_t>;
 	}
 	
 	// Specify the attribute arrays
@@ -71,67 +122,222 @@ public:
 		attributes_[n].stride = stride;
 		attributes_[n].buffer = buffer;
 	}
+
+	// With a divisor other than 0 attribute n is fetched per instance
+	// instead of per vertex. It advances by one element every divisor
+	// instances. 
+	void vertex_attrib_divisor(unsigned n, unsigned divisor)
+	{
+		assert(n < MAX_ATTRIBUTES);
+		attributes_[n].divisor = divisor;
+	}
 	
-	// Processes a list of vertices
-	void process(unsigned count, unsigned *indices)
+	// Constant data for the vertex shader, like the transformation matrix.
+	// A vertex shader which declares a uniform_type gets them passed to
+	// shade(in, out, uniforms) as a reference of that type. The pointer is
+	// read once per draw call, the data must not change during one.
+	void uniforms(const void *uniforms)
+	{ uniforms_ = uniforms; }
+
+	const void *uniforms() const
+	{ return uniforms_; }
+
+	// Index which ends the current strip or fan. The next index starts a
+	// new one. Not used for lists. 16 bit indices are compared with the
+	// lower 16 bits, so the default restarts at 0xffff there.
+	void restart_index(unsigned index)
+	{ restart_index_ = index; }
+
+	// Processes a list of vertices. Strips and fans are converted to a list
+	// of triangles for the derived class. The indices are 16 or 32 bit. The
+	// list is processed instance_count times with the per instance
+	// attributes (see vertex_attrib_divisor) of each instance, all in the
+	// same batches of the derived class.
+	void process(unsigned count, const uint16_t *indices, Topology topology = TOPOLOGY_LIST,
+		unsigned instance_count = 1)
+	{
+		if (process_func16_)
+			(this->*process_func16_)(count, indices, topology, instance_count);
+	}
+
+	void process(unsigned count, const uint32_t *indices, Topology topology = TOPOLOGY_LIST,
+		unsigned instance_count = 1)
 	{
-		if (process_func_)
-			(this->*process_func_)(count, indices);
+		if (process_func32_)
+			(this->*process_func32_)(count, indices, topology, instance_count);
 	}
 
 private:
 	struct Attribute {
 		unsigned stride;
 		const void* buffer;
+		unsigned divisor;
+		Attribute() : stride(0), buffer(0), divisor(0) {}
 	} attributes_[MAX_ATTRIBUTES];
+
+	const void *uniforms_;
+
+	// Where the attributes of the current instance are fetched from. Per
+	// instance attributes have a stride of 0 here.
+	struct {
+		const char *buffer[MAX_ATTRIBUTES];
+		unsigned stride[MAX_ATTRIBUTES];
+	} fetch_;
+
+	void setup_fetch(unsigned attribute_count, unsigned instance)
+	{
+		for (unsigned i = 0; i < attribute_count; ++i) {
+			const Attribute &a = attributes_[i];
+			fetch_.buffer[i] = static_cast<const char*>(a.buffer);
+			fetch_.stride[i] = a.stride;
+			if (a.divisor) {
+				fetch_.buffer[i] += instance / a.divisor * a.stride;
+				fetch_.stride[i] = 0;
+			}
+		}
+	}
 	
-	void (VertexProcessor<VertexType, Derived>::*process_func_)(unsigned, unsigned*);
+	void (VertexProcessor<VertexType, Derived>::*process_func16_)(unsigned, const uint16_t*, 
+		Topology, unsigned);
+	void (VertexProcessor<VertexType, Derived>::*process_func32_)(unsigned, const uint32_t*, 
+		Topology, unsigned);
+
+	unsigned restart_index_;
+
+	static const int VERTEX_CACHE_SIZE = 16;
+
+	struct PostTransformCache {
+		unsigned index_in, index_out;
+		PostTransformCache():index_in(-1) {}
+	};
 
+	// Returns the output index of the vertex with the given input index and
+	// calls the vertex shader if it is not in the cache.
 	template <typename VertexShader>
-	void process_template(unsigned count, unsigned* indices)
+	unsigned shade_vertex(unsigned index, PostTransformCache *vcache, unsigned &vertex_index,
+		const void *uniforms)
+	{
+		unsigned cache_index = index & (VERTEX_CACHE_SIZE - 1);
+		if (vcache[cache_index].index_in != index) {
+			VertexInput in;
+			for (unsigned i = 0; i < VertexShader::attribute_count; ++i)
+				in[i] = fetch_.buffer[i] + index * fetch_.stride[i];
+
+			VertexOutput& out = 
+				*static_cast<Derived*>(this)->acquire_output_location();
+			detail::ShadeCall<VertexShader>::shade(in, out, uniforms);
+			vcache[cache_index].index_in = index;
+			vcache[cache_index].index_out = vertex_index++;
+		}
+		return vcache[cache_index].index_out;
+	}
+
+	// Passes an output index on. Returns true if the derived class flushed
+	// its vertices, in which case the cache is cleared as well.
+	bool push_index(unsigned index, PostTransformCache *vcache, unsigned &vertex_index)
+	{
+		bool flush_cache = static_cast<Derived*>(this)->push_vertex_index(index);
+		if (flush_cache) {
+			vertex_index = 0;
+			for (int i = 0; i < VERTEX_CACHE_SIZE; ++i)
+				vcache[i].index_in = -1;
+		}
+		return flush_cache;
+	}
+
+	template <typename VertexShader, typename IndexType>
+	void process_template(unsigned index_count, const IndexType* index_data, Topology topology, 
+		unsigned instance_count)
 	{
 		assert(VertexShader::attribute_count <= MAX_ATTRIBUTES);
 #if 1
-		static const int VERTEX_CACHE_SIZE = 16;
-
-		struct PostTransformCache {
-			unsigned index_in, index_out;
-			PostTransformCache():index_in(-1) {}
-		} vcache[VERTEX_CACHE_SIZE];
+		PostTransformCache vcache[VERTEX_CACHE_SIZE];
 
 		unsigned vertex_index = 0;
 
-		VertexInput in;
+		// The two vertices of a strip or fan which the next triangle shares
+		// with the previous one (the first is the center of a fan) as input
+		// and as output indices. The first two vertices of a strip or fan are
+		// only shaded with the third, so a restart never leaves shaded
+		// vertices without indices behind. The output indices also become
+		// invalid when the derived class flushes, then these vertices are
+		// shaded again.
+		unsigned shared_in[2] = { 0, 0 };
+		unsigned shared_out[2] = { 0, 0 };
+		bool shared_invalid = true;
 
-		static_cast<Derived*>(this)->process_begin();
-		while (count--) {
-			unsigned index = *indices++;
+		// the number of vertices since the start of the strip or fan
+		unsigned primitive_vertex = 0;
 
-			for (unsigned i = 0; i < VertexShader::attribute_count; ++i) {
-				in[i] = static_cast<const char*>(attributes_[i].buffer) + 
-					index * attributes_[i].stride;
-			}
+		const unsigned restart = static_cast<IndexType>(restart_index_);
+		const void *uniforms = uniforms_;
 
-			unsigned cache_index = index & VERTEX_CACHE_SIZE - 1;
-			if (vcache[cache_index].index_in != index) {
-				VertexOutput& out = 
-					*static_cast<Derived*>(this)->acquire_output_location();
-				VertexShader::shade(in, out);
-				vcache[cache_index].index_in = index;
-				vcache[cache_index].index_out = vertex_index++;
-			}
+		static_cast<Derived*>(this)->process_begin();
+		for (unsigned instance = 0; instance < instance_count; ++instance) {
+			setup_fetch(VertexShader::attribute_count, instance);
 
-			bool flush_cache = static_cast<Derived*>(this)->push_vertex_index(
-				vcache[cache_index].index_out);
-			if (flush_cache) {
-				vertex_index = 0;
+			// the cached vertices belong to the previous instance
+			if (instance) {
 				for (int i = 0; i < VERTEX_CACHE_SIZE; ++i)
 					vcache[i].index_in = -1;
+				primitive_vertex = 0;
+				shared_invalid = true;
+			}
+
+			unsigned count = index_count;
+			const IndexType *indices = index_data;
+			while (count--) {
+				unsigned index = *indices++;
+
+				if (topology == TOPOLOGY_LIST) {
+					push_index(shade_vertex<VertexShader>(index, vcache, vertex_index, uniforms), 
+						vcache, vertex_index);
+					continue;
+				}
+
+				if (index == restart) {
+					primitive_vertex = 0;
+					shared_invalid = true;
+					continue;
+				}
+
+				if (primitive_vertex < 2) {
+					shared_in[primitive_vertex++] = index;
+					continue;
+				}
+
+				if (shared_invalid) {
+					shared_out[0] = shade_vertex<VertexShader>(shared_in[0], vcache, vertex_index, uniforms);
+					shared_out[1] = shade_vertex<VertexShader>(shared_in[1], vcache, vertex_index, uniforms);
+					shared_invalid = false;
+				}
+				const unsigned out = shade_vertex<VertexShader>(index, vcache, vertex_index, uniforms);
+
+				// every other triangle of a strip is reversed to keep the
+				// winding the same
+				const bool odd = topology == TOPOLOGY_STRIP && (primitive_vertex & 1);
+				push_index(shared_out[odd ? 1 : 0], vcache, vertex_index);
+				push_index(shared_out[odd ? 0 : 1], vcache, vertex_index);
+				shared_invalid = push_index(out, vcache, vertex_index);
+
+				if (topology == TOPOLOGY_STRIP) {
+					shared_in[0] = shared_in[1];
+					shared_out[0] = shared_out[1];
+					shared_in[1] = index;
+					shared_out[1] = out;
+				} else {
+					shared_in[1] = index;
+					shared_out[1] = out;
+				}
+
+				++primitive_vertex;
 			}
 		}
 		static_cast<Derived*>(this)->process_end();
 #else
 		// Try to do parallel processing of vertices (somehow slower? depends on cache size)
+		const unsigned count = index_count;
+		const IndexType *indices = index_data;
 		unsigned vertex_index = 0;
 		const int OUTPUT_CACHE_SIZE = 4096 * 3 + 4096 * 12;
 		static std::vector<VertexOutput> cache(OUTPUT_CACHE_SIZE);
@@ -151,7 +357,7 @@ private:
 						index * attributes_[i].stride;
 				}
 
-				VertexShader::shade(in, cache[j]);
+				detail::ShadeCall<VertexShader>::shade(in, cache[j], uniforms_);
 			}
 
 			for (int j = 0; j < loopcount; ++j) {
@@ -0,0 +1,306 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#include "culling.h"
+
+#include <cmath>
+#include <algorithm>
+
+// Define SWR_NO_SIMD to always use the scalar code.
+#if !defined(SWR_NO_SIMD)
+#	if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#		define SWR_SSE2 1
+#		include <emmintrin.h>
+#	elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#		define SWR_NEON 1
+#		include <arm_neon.h>
+#	endif
+#endif
+
+namespace culling {
+
+Frustum frustum_from_matrix(const vmath::mat4<float> &m)
+{
+	// Gribb and Hartmann: each plane is the last row of the matrix plus or
+	// minus one of the others.
+	Frustum f;
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			f.planes[i * 2 + 0][j] = m.elem[3][j] + m.elem[i][j];
+			f.planes[i * 2 + 1][j] = m.elem[3][j] - m.elem[i][j];
+		}
+	}
+
+	for (int i = 0; i < 6; ++i) {
+		float *p = f.planes[i];
+		const float l = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		if (l > 0) {
+			const float ool = 1.0f / l;
+			for (int j = 0; j < 4; ++j)
+				p[j] *= ool;
+		}
+	}
+
+	return f;
+}
+
+bool test_sphere(const Frustum &f, const BoundingSphere &s)
+{
+	for (int i = 0; i < 6; ++i) {
+		const float *p = f.planes[i];
+		if (p[0] * s.center.x + p[1] * s.center.y + p[2] * s.center.z + p[3] < -s.radius)
+			return false;
+	}
+	return true;
+}
+
+bool test_box(const Frustum &f, const BoundingBox &b)
+{
+	// distance of the box corner farthest inside along the plane normal
+	for (int i = 0; i < 6; ++i) {
+		const float *p = f.planes[i];
+		const float x = p[0] >= 0 ? b.max.x : b.min.x;
+		const float y = p[1] >= 0 ? b.max.y : b.min.y;
+		const float z = p[2] >= 0 ? b.max.z : b.min.z;
+		if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0)
+			return false;
+	}
+	return true;
+}
+
+#if defined(SWR_SSE2)
+
+size_t cull_spheres(const Frustum &f, const BoundingSphere *spheres, size_t count, unsigned *visible)
+{
+	size_t n = 0;
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		// BoundingSphere is four floats; transpose four of them into x, y,
+		// z and radius of four spheres
+		__m128 x = _mm_loadu_ps(&spheres[i + 0].center.x);
+		__m128 y = _mm_loadu_ps(&spheres[i + 1].center.x);
+		__m128 z = _mm_loadu_ps(&spheres[i + 2].center.x);
+		__m128 r = _mm_loadu_ps(&spheres[i + 3].center.x);
+		_MM_TRANSPOSE4_PS(x, y, z, r);
+
+		const __m128 neg_r = _mm_sub_ps(_mm_setzero_ps(), r);
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int j = 0; j < 6; ++j) {
+			const float *p = f.planes[j];
+			__m128 d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(p[0])), _mm_set1_ps(p[3]));
+			d = _mm_add_ps(d, _mm_mul_ps(y, _mm_set1_ps(p[1])));
+			d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(p[2])));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, neg_r));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		for (int k = 0; k < 4; ++k)
+			if (mask & (1 << k))
+				visible[n++] = static_cast<unsigned>(i + k);
+	}
+
+	for (; i < count; ++i)
+		if (test_sphere(f, spheres[i]))
+			visible[n++] = static_cast<unsigned>(i);
+
+	return n;
+}
+
+size_t cull_boxes(const Frustum &f, const BoundingBox *boxes, size_t count, unsigned *visible)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+	size_t n = 0;
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		const BoundingBox *b = boxes + i;
+		const __m128 min_x = _mm_setr_ps(b[0].min.x, b[1].min.x, b[2].min.x, b[3].min.x);
+		const __m128 min_y = _mm_setr_ps(b[0].min.y, b[1].min.y, b[2].min.y, b[3].min.y);
+		const __m128 min_z = _mm_setr_ps(b[0].min.z, b[1].min.z, b[2].min.z, b[3].min.z);
+		const __m128 max_x = _mm_setr_ps(b[0].max.x, b[1].max.x, b[2].max.x, b[3].max.x);
+		const __m128 max_y = _mm_setr_ps(b[0].max.y, b[1].max.y, b[2].max.y, b[3].max.y);
+		const __m128 max_z = _mm_setr_ps(b[0].max.z, b[1].max.z, b[2].max.z, b[3].max.z);
+
+		// center and half extent; a box is outside a plane if the center is
+		// farther outside than the projection of the extent on the normal
+		const __m128 cx = _mm_mul_ps(_mm_add_ps(min_x, max_x), half);
+		const __m128 cy = _mm_mul_ps(_mm_add_ps(min_y, max_y), half);
+		const __m128 cz = _mm_mul_ps(_mm_add_ps(min_z, max_z), half);
+		const __m128 ex = _mm_mul_ps(_mm_sub_ps(max_x, min_x), half);
+		const __m128 ey = _mm_mul_ps(_mm_sub_ps(max_y, min_y), half);
+		const __m128 ez = _mm_mul_ps(_mm_sub_ps(max_z, min_z), half);
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int j = 0; j < 6; ++j) {
+			const float *p = f.planes[j];
+			const __m128 a = _mm_set1_ps(p[0]);
+			const __m128 b = _mm_set1_ps(p[1]);
+			const __m128 c = _mm_set1_ps(p[2]);
+
+			__m128 d = _mm_add_ps(_mm_mul_ps(cx, a), _mm_set1_ps(p[3]));
+			d = _mm_add_ps(d, _mm_mul_ps(cy, b));
+			d = _mm_add_ps(d, _mm_mul_ps(cz, c));
+
+			__m128 e = _mm_mul_ps(ex, _mm_and_ps(a, abs_mask));
+			e = _mm_add_ps(e, _mm_mul_ps(ey, _mm_and_ps(b, abs_mask)));
+			e = _mm_add_ps(e, _mm_mul_ps(ez, _mm_and_ps(c, abs_mask)));
+
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, e), _mm_setzero_ps()));
+		}
+
+		const int mask = _mm_movemask_ps(inside);
+		for (int k = 0; k < 4; ++k)
+			if (mask & (1 << k))
+				visible[n++] = static_cast<unsigned>(i + k);
+	}
+
+	for (; i < count; ++i)
+		if (test_box(f, boxes[i]))
+			visible[n++] = static_cast<unsigned>(i);
+
+	return n;
+}
+
+#elif defined(SWR_NEON)
+
+size_t cull_spheres(const Frustum &f, const BoundingSphere *spheres, size_t count, unsigned *visible)
+{
+	size_t n = 0;
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		// BoundingSphere is four floats; deinterleave four of them into x,
+		// y, z and radius of four spheres
+		const float32x4x4_t s = vld4q_f32(&spheres[i].center.x);
+		const float32x4_t neg_r = vnegq_f32(s.val[3]);
+
+		uint32x4_t inside = vdupq_n_u32(0xffffffff);
+		for (int j = 0; j < 6; ++j) {
+			const float *p = f.planes[j];
+			float32x4_t d = vmlaq_n_f32(vdupq_n_f32(p[3]), s.val[0], p[0]);
+			d = vmlaq_n_f32(d, s.val[1], p[1]);
+			d = vmlaq_n_f32(d, s.val[2], p[2]);
+			inside = vandq_u32(inside, vcgeq_f32(d, neg_r));
+		}
+
+		uint32_t mask[4];
+		vst1q_u32(mask, inside);
+		for (int k = 0; k < 4; ++k)
+			if (mask[k])
+				visible[n++] = static_cast<unsigned>(i + k);
+	}
+
+	for (; i < count; ++i)
+		if (test_sphere(f, spheres[i]))
+			visible[n++] = static_cast<unsigned>(i);
+
+	return n;
+}
+
+size_t cull_boxes(const Frustum &f, const BoundingBox *boxes, size_t count, unsigned *visible)
+{
+	size_t n = 0;
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		// gather the center and half extent of four boxes
+		float c[3][4], e[3][4];
+		for (int k = 0; k < 4; ++k) {
+			const BoundingBox &b = boxes[i + k];
+			c[0][k] = (b.min.x + b.max.x) * 0.5f; e[0][k] = (b.max.x - b.min.x) * 0.5f;
+			c[1][k] = (b.min.y + b.max.y) * 0.5f; e[1][k] = (b.max.y - b.min.y) * 0.5f;
+			c[2][k] = (b.min.z + b.max.z) * 0.5f; e[2][k] = (b.max.z - b.min.z) * 0.5f;
+		}
+
+		const float32x4_t cx = vld1q_f32(c[0]), cy = vld1q_f32(c[1]), cz = vld1q_f32(c[2]);
+		const float32x4_t ex = vld1q_f32(e[0]), ey = vld1q_f32(e[1]), ez = vld1q_f32(e[2]);
+
+		uint32x4_t inside = vdupq_n_u32(0xffffffff);
+		for (int j = 0; j < 6; ++j) {
+			const float *p = f.planes[j];
+			float32x4_t d = vmlaq_n_f32(vdupq_n_f32(p[3]), cx, p[0]);
+			d = vmlaq_n_f32(d, cy, p[1]);
+			d = vmlaq_n_f32(d, cz, p[2]);
+			d = vmlaq_n_f32(d, ex, std::fabs(p[0]));
+			d = vmlaq_n_f32(d, ey, std::fabs(p[1]));
+			d = vmlaq_n_f32(d, ez, std::fabs(p[2]));
+			inside = vandq_u32(inside, vcgeq_f32(d, vdupq_n_f32(0)));
+		}
+
+		uint32_t mask[4];
+		vst1q_u32(mask, inside);
+		for (int k = 0; k < 4; ++k)
+			if (mask[k])
+				visible[n++] = static_cast<unsigned>(i + k);
+	}
+
+	for (; i < count; ++i)
+		if (test_box(f, boxes[i]))
+			visible[n++] = static_cast<unsigned>(i);
+
+	return n;
+}
+
+#else
+
+size_t cull_spheres(const Frustum &f, const BoundingSphere *spheres, size_t count, unsigned *visible)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < count; ++i)
+		if (test_sphere(f, spheres[i]))
+			visible[n++] = static_cast<unsigned>(i);
+	return n;
+}
+
+size_t cull_boxes(const Frustum &f, const BoundingBox *boxes, size_t count, unsigned *visible)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < count; ++i)
+		if (test_box(f, boxes[i]))
+			visible[n++] = static_cast<unsigned>(i);
+	return n;
+}
+
+#endif
+
+BoundingBox bounding_box(const vmath::vec3<float> *positions, size_t count, size_t stride)
+{
+	BoundingBox b;
+	b.min = b.max = vmath::vec3<float>(0.0f);
+
+	const char *p = reinterpret_cast<const char*>(positions);
+	for (size_t i = 0; i < count; ++i, p += stride) {
+		const vmath::vec3<float> &v = *reinterpret_cast<const vmath::vec3<float>*>(p);
+		if (i == 0) {
+			b.min = b.max = v;
+			continue;
+		}
+		b.min.x = (std::min)(b.min.x, v.x); b.max.x = (std::max)(b.max.x, v.x);
+		b.min.y = (std::min)(b.min.y, v.y); b.max.y = (std::max)(b.max.y, v.y);
+		b.min.z = (std::min)(b.min.z, v.z); b.max.z = (std::max)(b.max.z, v.z);
+	}
+
+	return b;
+}
+
+BoundingSphere bounding_sphere(const vmath::vec3<float> *positions, size_t count, size_t stride)
+{
+	const BoundingBox b = bounding_box(positions, count, stride);
+
+	BoundingSphere s;
+	s.center = (b.min + b.max) * 0.5f;
+
+	float r2 = 0;
+	const char *p = reinterpret_cast<const char*>(positions);
+	for (size_t i = 0; i < count; ++i, p += stride) {
+		const vmath::vec3<float> d = *reinterpret_cast<const vmath::vec3<float>*>(p) - s.center;
+		r2 = (std::max)(r2, vmath::dot(d, d));
+	}
+	s.radius = std::sqrt(r2);
+
+	return s;
+}
+
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef CULLING_H_
+#define CULLING_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vector_math.h"
+
+#include <cstddef>
+
+// View frustum culling of whole objects before they are drawn. The geometry
+// processor clips every batch of triangles, but only after all vertices are
+// shaded, which is wasted work for objects that are completely off screen.
+// Testing a bounding volume per object is much cheaper.
+//
+// Typical use once per frame:
+//
+//   culling::Frustum f = culling::frustum_from_matrix(projection * view);
+//   size_t n = culling::cull_spheres(f, &spheres[0], spheres.size(), &visible[0]);
+//   for (size_t i = 0; i < n; ++i)
+//     draw_object(visible[i]);
+//
+// The bounding volumes are in the space the matrix transforms from, e.g.
+// world space for a view projection matrix. The tests are conservative:
+// objects which intersect the frustum or are only close to a corner of it
+// are reported visible.
+namespace culling {
+
+struct BoundingSphere {
+	vmath::vec3<float> center;
+	float radius;
+};
+
+struct BoundingBox {
+	vmath::vec3<float> min;
+	vmath::vec3<float> max;
+};
+
+// The six planes (a, b, c, d) of the view frustum with normals pointing
+// inside. A point p is inside a plane if a*p.x + b*p.y + c*p.z + d >= 0.
+// The normals have unit length so that the value is the distance to the
+// plane.
+struct Frustum {
+	float planes[6][4];
+};
+
+// Extracts the frustum from a (model) view projection matrix which maps to
+// the clip space of the geometry processor (-w <= x, y, z <= w).
+Frustum frustum_from_matrix(const vmath::mat4<float> &m);
+
+bool test_sphere(const Frustum &f, const BoundingSphere &s);
+bool test_box(const Frustum &f, const BoundingBox &b);
+
+// Test count bounding volumes and write the indices of the visible ones to
+// visible, which must have space for count entries. Returns the number of
+// visible objects. Four objects are tested at a time with SSE2 or NEON.
+size_t cull_spheres(const Frustum &f, const BoundingSphere *spheres, size_t count, unsigned *visible);
+size_t cull_boxes(const Frustum &f, const BoundingBox *boxes, size_t count, unsigned *visible);
+
+// Bounding volumes of count positions which are stride bytes apart, e.g.
+// the vertex array of a mesh. The sphere is centered on the bounding box
+// and therefore not minimal, but good enough for culling.
+BoundingBox bounding_box(const vmath::vec3<float> *positions, size_t count, size_t stride = sizeof(vmath::vec3<float>));
+BoundingSphere bounding_sphere(const vmath::vec3<float> *positions, size_t count, size_t stride = sizeof(vmath::vec3<float>));
+
+}
+
+#endif
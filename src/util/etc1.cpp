@@ -0,0 +1,201 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#include "etc1.h"
+
+#include "renderer/compressed_texture.h"
+
+using swr::ETC1;
+
+namespace {
+	int channel(uint32_t p, int c)
+	{
+		return (p >> (c * 8)) & 0xff;
+	}
+
+	struct HalfBlock {
+		unsigned table;
+		unsigned indices[8];
+		int error;
+	};
+
+	// finds the best table and the indices for the 8 texels of a half
+	// block with the given base color
+	void encode_half(const uint32_t *texels, const int *base, HalfBlock &result)
+	{
+		result.error = 0x7fffffff;
+
+		for (unsigned t = 0; t < 8; ++t) {
+			HalfBlock h;
+			h.table = t;
+			h.error = 0;
+
+			for (int i = 0; i < 8; ++i) {
+				int best = 0x7fffffff;
+				for (unsigned index = 0; index < 4; ++index) {
+					const int m = ETC1::modifier(t, index);
+					int e = 0;
+					for (int c = 0; c < 3; ++c) {
+						const int d = ETC1::clamp255(base[c] + m) - channel(texels[i], c);
+						e += d * d;
+					}
+					if (e < best) {
+						best = e;
+						h.indices[i] = index;
+					}
+				}
+				h.error += best;
+			}
+
+			if (h.error < result.error)
+				result = h;
+		}
+	}
+
+	// compresses 16 texels given in row-major order
+	void encode_block(const uint32_t *texels, uint8_t *block)
+	{
+		int best_error = 0x7fffffff;
+		uint32_t best_hi = 0, best_lo = 0;
+
+		for (int flip = 0; flip < 2; ++flip) {
+			// the texels of the two halves and where they are in the block
+			uint32_t half_texels[2][8];
+			unsigned half_pos[2][8];
+			unsigned count[2] = {0, 0};
+			for (unsigned y = 0; y < 4; ++y) {
+				for (unsigned x = 0; x < 4; ++x) {
+					const unsigned half = flip ? (y >= 2) : (x >= 2);
+					half_pos[half][count[half]] = x * 4 + y;
+					half_texels[half][count[half]++] = texels[y * 4 + x];
+				}
+			}
+
+			int avg[2][3];
+			for (int h = 0; h < 2; ++h) {
+				for (int c = 0; c < 3; ++c) {
+					int sum = 0;
+					for (int i = 0; i < 8; ++i)
+						sum += channel(half_texels[h][i], c);
+					avg[h][c] = (sum + 4) / 8;
+				}
+			}
+
+			// use differential mode if the 5 bit colors are close enough,
+			// otherwise two 4 bit colors
+			int q[2][3];
+			bool diff = true;
+			for (int c = 0; c < 3; ++c) {
+				q[0][c] = (avg[0][c] * 31 + 127) / 255;
+				q[1][c] = (avg[1][c] * 31 + 127) / 255;
+				const int d = q[1][c] - q[0][c];
+				if (d < -4 || d > 3) diff = false;
+			}
+
+			int base[2][3];
+			uint32_t hi = 0;
+			for (int c = 0; c < 3; ++c) {
+				const int shift = 27 - c * 8;
+				if (diff) {
+					base[0][c] = q[0][c] << 3 | q[0][c] >> 2;
+					base[1][c] = q[1][c] << 3 | q[1][c] >> 2;
+					hi |= uint32_t(q[0][c]) << shift;
+					hi |= uint32_t((q[1][c] - q[0][c]) & 7) << (shift - 3);
+				} else {
+					const int q1 = (avg[0][c] * 15 + 127) / 255;
+					const int q2 = (avg[1][c] * 15 + 127) / 255;
+					base[0][c] = q1 * 17;
+					base[1][c] = q2 * 17;
+					hi |= uint32_t(q1) << (shift + 1);
+					hi |= uint32_t(q2) << (shift - 3);
+				}
+			}
+
+			HalfBlock halves[2];
+			encode_half(half_texels[0], base[0], halves[0]);
+			encode_half(half_texels[1], base[1], halves[1]);
+
+			const int error = halves[0].error + halves[1].error;
+			if (error >= best_error)
+				continue;
+
+			hi |= halves[0].table << 5 | halves[1].table << 2;
+			hi |= (diff ? 2 : 0) | flip;
+
+			uint32_t lo = 0;
+			for (int h = 0; h < 2; ++h) {
+				for (int i = 0; i < 8; ++i) {
+					const unsigned pos = half_pos[h][i];
+					const unsigned index = halves[h].indices[i];
+					lo |= uint32_t(index >> 1) << (pos + 16);
+					lo |= uint32_t(index & 1) << pos;
+				}
+			}
+
+			best_error = error;
+			best_hi = hi;
+			best_lo = lo;
+		}
+
+		for (int i = 0; i < 4; ++i) {
+			block[i] = static_cast<uint8_t>(best_hi >> (24 - i * 8));
+			block[i + 4] = static_cast<uint8_t>(best_lo >> (24 - i * 8));
+		}
+	}
+
+	void compress_level(const std::vector<uint32_t> &image, unsigned width, unsigned height,
+		std::vector<uint8_t> &out)
+	{
+		for (unsigned by = 0; by < height; by += 4) {
+			for (unsigned bx = 0; bx < width; bx += 4) {
+				// levels smaller than a block repeat their texels
+				uint32_t texels[16];
+				for (unsigned y = 0; y < 4; ++y)
+					for (unsigned x = 0; x < 4; ++x)
+						texels[y * 4 + x] = image[((by + y) % height) * width + (bx + x) % width];
+
+				const size_t offset = out.size();
+				out.resize(offset + ETC1::BLOCK_SIZE);
+				encode_block(texels, &out[offset]);
+			}
+		}
+	}
+}
+
+int etc1_compress(const uint32_t *pixels, unsigned width, unsigned height,
+	unsigned pitch, bool mipmaps, std::vector<uint8_t> &out)
+{
+	std::vector<uint32_t> image(width * height);
+	for (unsigned y = 0; y < height; ++y)
+		for (unsigned x = 0; x < width; ++x)
+			image[y * width + x] = pixels[y * pitch + x];
+
+	int level_count = 0;
+	for (;;) {
+		compress_level(image, width, height, out);
+		++level_count;
+
+		if (!mipmaps || (width == 1 && height == 1))
+			break;
+
+		// box filter for the next level
+		const unsigned w = width > 1 ? width / 2 : 1;
+		const unsigned h = height > 1 ? height / 2 : 1;
+		const unsigned sx = width / w, sy = height / h;
+
+		std::vector<uint32_t> next(w * h);
+		for (unsigned y = 0; y < h; ++y) {
+			for (unsigned x = 0; x < w; ++x) {
+				const uint32_t *row0 = &image[(y * sy) * width];
+				const uint32_t *row1 = &image[(y * sy + sy - 1) * width];
+				const unsigned x0 = x * sx, x1 = x * sx + sx - 1;
+				next[y * w + x] = swr::RGBA8888::average(row0[x0], row0[x1], row1[x0], row1[x1]);
+			}
+		}
+
+		image.swap(next);
+		width = w;
+		height = h;
+	}
+
+	return level_count;
+}
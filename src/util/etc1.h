@@ -0,0 +1,25 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef ETC1_H_
+#define ETC1_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <vector>
+#include <stdint.h>
+
+// Compresses an image to ETC1 for swr::CompressedTexture. The pixels have 8
+// bit channels with red in the lowest byte (the layout of swr::RGBA8888);
+// alpha is ignored. pitch is given in pixels. With mipmaps set all levels
+// down to 1x1 are generated and compressed too. The blocks are appended to
+// out in the layout CompressedTexture::create expects.
+//
+// The encoder tries both block orientations and all modifier tables for
+// each half but only uses the average color as base, so it is fast but not
+// of the best possible quality. Returns the number of levels.
+int etc1_compress(const uint32_t *pixels, unsigned width, unsigned height,
+	unsigned pitch, bool mipmaps, std::vector<uint8_t> &out);
+
+#endif
@@ -0,0 +1,354 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#include "lod.h"
+#include "meshopt.h"
+
+#include <cmath>
+#include <algorithm>
+#include <utility>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+namespace lod {
+
+namespace {
+	const vmath::vec3<float>& position(const vmath::vec3<float> *positions, size_t stride, unsigned i)
+	{
+		return *reinterpret_cast<const vmath::vec3<float>*>(
+			reinterpret_cast<const char*>(positions) + i * stride);
+	}
+
+	// Sum of squared distances to a set of planes, weighted by the area of
+	// the triangles the planes come from.
+	struct Quadric {
+		double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+		double weight;
+
+		Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0), weight(0) {}
+
+		void add_plane(double a, double b, double c, double d, double w)
+		{
+			a2 += a * a * w; ab += a * b * w; ac += a * c * w; ad += a * d * w;
+			b2 += b * b * w; bc += b * c * w; bd += b * d * w;
+			c2 += c * c * w; cd += c * d * w;
+			d2 += d * d * w;
+			weight += w;
+		}
+
+		void add(const Quadric &q)
+		{
+			a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+			b2 += q.b2; bc += q.bc; bd += q.bd;
+			c2 += q.c2; cd += q.cd;
+			d2 += q.d2;
+			weight += q.weight;
+		}
+
+		// the mean squared distance of p to the planes
+		double error(const vmath::vec3<float> &p) const
+		{
+			const double x = p.x, y = p.y, z = p.z;
+			const double e =
+				a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+				b2 * y * y + 2 * bc * y * z + 2 * bd * y +
+				c2 * z * z + 2 * cd * z +
+				d2;
+			return weight > 0 ? (std::max)(e / weight, 0.0) : 0;
+		}
+	};
+
+	struct Collapse {
+		unsigned from, to; // vertex indices
+		double cost;
+
+		bool operator < (const Collapse &c) const { return cost < c.cost; }
+	};
+
+	struct PositionLess {
+		const vmath::vec3<float> *positions;
+		size_t stride;
+
+		bool operator () (unsigned a, unsigned b) const
+		{
+			const vmath::vec3<float> &pa = position(positions, stride, a);
+			const vmath::vec3<float> &pb = position(positions, stride, b);
+			if (pa.x != pb.x) return pa.x < pb.x;
+			if (pa.y != pb.y) return pa.y < pb.y;
+			if (pa.z != pb.z) return pa.z < pb.z;
+			return a < b;
+		}
+	};
+
+	vmath::vec3<float> triangle_normal(const vmath::vec3<float> &p0, const vmath::vec3<float> &p1,
+		const vmath::vec3<float> &p2)
+	{
+		return vmath::cross(p1 - p0, p2 - p0);
+	}
+}
+
+size_t simplify(unsigned *destination, const unsigned *indices, size_t count,
+	const vmath::vec3<float> *positions, size_t vertex_count,
+	size_t stride, size_t target_count, float *error)
+{
+	using namespace vmath;
+
+	std::vector<unsigned> result(indices, indices + count / 3 * 3);
+
+	// Vertices with the same position are welded to the one with the
+	// smallest index. Topology and quadrics use the welded vertices.
+	std::vector<unsigned> weld(vertex_count);
+	{
+		std::vector<unsigned> order(vertex_count);
+		for (size_t i = 0; i < vertex_count; ++i)
+			order[i] = static_cast<unsigned>(i);
+		PositionLess less = {positions, stride};
+		std::sort(order.begin(), order.end(), less);
+
+		for (size_t i = 0; i < vertex_count; ++i) {
+			bool same = false;
+			if (i > 0) {
+				const vec3<float> &a = position(positions, stride, order[i - 1]);
+				const vec3<float> &b = position(positions, stride, order[i]);
+				same = a.x == b.x && a.y == b.y && a.z == b.z;
+			}
+			weld[order[i]] = same ? weld[order[i - 1]] : order[i];
+		}
+	}
+
+	// Locked vertices are never collapsed: seams (more than one used vertex
+	// at a position), borders and non-manifold edges.
+	std::vector<bool> locked(vertex_count, false);
+	{
+		std::vector<unsigned> used(vertex_count, ~0u);
+		for (size_t i = 0; i < result.size(); ++i) {
+			unsigned &u = used[weld[result[i]]];
+			if (u == ~0u)
+				u = result[i];
+			else if (u != result[i])
+				locked[weld[result[i]]] = true;
+		}
+
+		std::vector< std::pair<unsigned, unsigned> > edges;
+		edges.reserve(result.size());
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int k = 0; k < 3; ++k) {
+				const unsigned a = weld[result[i + k]];
+				const unsigned b = weld[result[i + (k + 1) % 3]];
+				edges.push_back(std::make_pair((std::min)(a, b), (std::max)(a, b)));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+
+		for (size_t i = 0; i < edges.size(); ) {
+			size_t j = i + 1;
+			while (j < edges.size() && edges[j] == edges[i])
+				++j;
+			if (j - i != 2) {
+				locked[edges[i].first] = true;
+				locked[edges[i].second] = true;
+			}
+			i = j;
+		}
+	}
+
+	std::vector<Quadric> quadrics(vertex_count);
+	for (size_t i = 0; i < result.size(); i += 3) {
+		const unsigned w0 = weld[result[i + 0]];
+		const unsigned w1 = weld[result[i + 1]];
+		const unsigned w2 = weld[result[i + 2]];
+		const vec3<float> &p0 = position(positions, stride, w0);
+		const vec3<float> n = triangle_normal(p0, position(positions, stride, w1), position(positions, stride, w2));
+		const double l = length(n);
+		if (l == 0)
+			continue;
+		const double a = n.x / l, b = n.y / l, c = n.z / l;
+		const double d = -(a * p0.x + b * p0.y + c * p0.z);
+		Quadric q;
+		q.add_plane(a, b, c, d, l * 0.5);
+		quadrics[w0].add(q);
+		quadrics[w1].add(q);
+		quadrics[w2].add(q);
+	}
+
+	double max_cost = 0;
+
+	std::vector<unsigned> adjacency_offset(vertex_count + 1);
+	std::vector<unsigned> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned> remap(vertex_count);
+	std::vector<bool> touched(vertex_count);
+
+	// Every pass collapses a set of independent edges in the order of their
+	// cost, then rebuilds the index list.
+	while (result.size() > target_count) {
+		const size_t triangle_count = result.size() / 3;
+
+		std::fill(adjacency_offset.begin(), adjacency_offset.end(), 0);
+		for (size_t i = 0; i < result.size(); ++i)
+			adjacency_offset[weld[result[i]] + 1]++;
+		for (size_t i = 0; i < vertex_count; ++i)
+			adjacency_offset[i + 1] += adjacency_offset[i];
+		adjacency.resize(result.size());
+		{
+			std::vector<unsigned> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+			for (size_t i = 0; i < result.size(); ++i)
+				adjacency[fill[weld[result[i]]]++] = static_cast<unsigned>(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t i = 0; i < result.size(); i += 3) {
+			for (int k = 0; k < 3; ++k) {
+				const unsigned a = result[i + k];
+				const unsigned b = result[i + (k + 1) % 3];
+				const unsigned wa = weld[a], wb = weld[b];
+
+				Quadric q = quadrics[wa];
+				q.add(quadrics[wb]);
+
+				if (!locked[wa]) {
+					Collapse c = {a, b, q.error(position(positions, stride, wb))};
+					collapses.push_back(c);
+				}
+				if (!locked[wb]) {
+					Collapse c = {b, a, q.error(position(positions, stride, wa))};
+					collapses.push_back(c);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		for (size_t i = 0; i < vertex_count; ++i)
+			remap[i] = static_cast<unsigned>(i);
+		std::fill(touched.begin(), touched.end(), false);
+
+		size_t removed = 0;
+		size_t collapsed = 0;
+		const size_t target_triangles = target_count / 3;
+
+		for (size_t c = 0; c < collapses.size() && triangle_count - removed > target_triangles; ++c) {
+			const unsigned from = collapses[c].from, to = collapses[c].to;
+			const unsigned wf = weld[from], wt = weld[to];
+			if (touched[wf] || touched[wt])
+				continue;
+
+			// reject the collapse if a remaining triangle would flip
+			const vec3<float> &target = position(positions, stride, wt);
+			bool flip = false;
+			size_t degenerate = 0;
+			for (unsigned a = adjacency_offset[wf]; a < adjacency_offset[wf + 1] && !flip; ++a) {
+				const unsigned *tri = &result[adjacency[a] * 3];
+				const unsigned w[3] = {weld[tri[0]], weld[tri[1]], weld[tri[2]]};
+				if (w[0] == wt || w[1] == wt || w[2] == wt) {
+					++degenerate;
+					continue;
+				}
+
+				vec3<float> p[3];
+				for (int k = 0; k < 3; ++k)
+					p[k] = position(positions, stride, w[k]);
+				const vec3<float> before = triangle_normal(p[0], p[1], p[2]);
+				for (int k = 0; k < 3; ++k)
+					if (w[k] == wf)
+						p[k] = target;
+				const vec3<float> after = triangle_normal(p[0], p[1], p[2]);
+				flip = dot(before, after) <= 0;
+			}
+			if (flip)
+				continue;
+
+			for (unsigned a = adjacency_offset[wf]; a < adjacency_offset[wf + 1]; ++a) {
+				const unsigned *tri = &result[adjacency[a] * 3];
+				for (int k = 0; k < 3; ++k)
+					touched[weld[tri[k]]] = true;
+			}
+
+			// from is not on a seam, so it is the only vertex at its position
+			remap[from] = to;
+			quadrics[wt].add(quadrics[wf]);
+			max_cost = (std::max)(max_cost, collapses[c].cost);
+
+			removed += degenerate;
+			++collapsed;
+		}
+
+		if (!collapsed)
+			break;
+
+		size_t n = 0;
+		for (size_t i = 0; i < result.size(); i += 3) {
+			const unsigned a = remap[result[i + 0]];
+			const unsigned b = remap[result[i + 1]];
+			const unsigned c = remap[result[i + 2]];
+			if (weld[a] == weld[b] || weld[b] == weld[c] || weld[a] == weld[c])
+				continue;
+			result[n++] = a;
+			result[n++] = b;
+			result[n++] = c;
+		}
+		result.resize(n);
+	}
+
+	std::copy(result.begin(), result.end(), destination);
+	if (error)
+		*error = static_cast<float>(std::sqrt(max_cost));
+	return result.size();
+}
+
+void build_chain(std::vector<Level> &levels, std::vector<unsigned> &lod_indices,
+	const unsigned *indices, size_t count,
+	const vmath::vec3<float> *positions, size_t vertex_count,
+	size_t stride, unsigned max_levels, float ratio)
+{
+	levels.clear();
+	lod_indices.assign(indices, indices + count);
+
+	Level l = {0, static_cast<unsigned>(count), 0.0f};
+	levels.push_back(l);
+
+	// nothing to simplify without a triangle
+	if (count < 3)
+		return;
+
+	std::vector<unsigned> simplified(count);
+	while (levels.size() < max_levels) {
+		const Level &prev = levels.back();
+		const size_t target = static_cast<size_t>(prev.index_count / 3 * ratio) * 3;
+
+		float error = 0;
+		const size_t n = simplify(&simplified[0], &lod_indices[prev.index_offset], prev.index_count,
+			positions, vertex_count, stride, target, &error);
+
+		// give up if the mesh does not get much simpler anymore
+		if (n == 0 || n > prev.index_count - prev.index_count / 8)
+			break;
+
+		meshopt::optimize_vertex_cache(&simplified[0], n, vertex_count);
+
+		// the errors of the steps add up
+		Level next = {static_cast<unsigned>(lod_indices.size()), static_cast<unsigned>(n),
+			prev.error + error};
+		lod_indices.insert(lod_indices.end(), simplified.begin(), simplified.begin() + n);
+		levels.push_back(next);
+	}
+}
+
+float projection_scale(float fovy, int viewport_height)
+{
+	return viewport_height / (2 * std::tan(fovy * 0.5f * float(M_PI / 180)));
+}
+
+size_t select(const Level *levels, size_t count, float distance, float scale, float pixel_error)
+{
+	if (distance <= 0)
+		return 0;
+
+	for (size_t i = count; i > 1; --i) {
+		if (levels[i - 1].error * scale <= pixel_error * distance)
+			return i - 1;
+	}
+	return 0;
+}
+
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef LOD_H_
+#define LOD_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "vector_math.h"
+
+#include <vector>
+#include <cstddef>
+
+// Level of detail: simplified versions of a mesh for drawing it small on
+// screen with fewer triangles, and the selection of the level to draw by its
+// error in pixels.
+//
+// Typical use after loading a mesh:
+//
+//   std::vector<lod::Level> levels;
+//   std::vector<unsigned> lod_indices;
+//   lod::build_chain(levels, lod_indices, &idata[0], idata.size(),
+//     &vdata[0].vertex, vdata.size(), sizeof(ObjData::VertexArrayData));
+//
+// and every frame:
+//
+//   const lod::Level &l = levels[lod::select(&levels[0], levels.size(),
+//     distance, lod::projection_scale(fovy, height))];
+//   g.draw_triangles(l.index_count, &lod_indices[l.index_offset]);
+//
+// All levels use the original vertex array, only the index lists differ.
+namespace lod {
+
+struct Level {
+	// the triangles are lod_indices[index_offset] .. lod_indices[index_offset + index_count - 1]
+	unsigned index_offset;
+	unsigned index_count;
+
+	// how far the level deviates from the original mesh, in units of the
+	// positions
+	float error;
+};
+
+// Simplifies a triangle list to at most target_count indices if possible
+// by collapsing edges with the smallest quadric error (Garland and
+// Heckbert). A vertex is always collapsed onto one of its neighbours, so no
+// new vertices are needed. Vertices on the border of the mesh and on
+// attribute seams (several vertices with the same position, e.g. different
+// texture coordinates) are kept, so fewer indices than requested may be
+// removed. Writes the result to destination, which must have space for
+// count indices, and returns the number of indices written. If error is
+// given it receives the deviation from the input.
+size_t simplify(unsigned *destination, const unsigned *indices, size_t count,
+	const vmath::vec3<float> *positions, size_t vertex_count,
+	size_t stride, size_t target_count, float *error = 0);
+
+// Builds up to max_levels levels. Level 0 is the original mesh, every
+// following level has about ratio times the triangles of the previous one.
+// Stops early when a mesh cannot be simplified further. The index lists of
+// all levels are stored in lod_indices and ordered for the post-transform
+// cache.
+void build_chain(std::vector<Level> &levels, std::vector<unsigned> &lod_indices,
+	const unsigned *indices, size_t count,
+	const vmath::vec3<float> *positions, size_t vertex_count,
+	size_t stride = sizeof(vmath::vec3<float>),
+	unsigned max_levels = 5, float ratio = 0.5f);
+
+// Pixels per unit at distance 1 for a perspective projection with the
+// vertical field of view fovy (in degrees, as for vmath::perspective_matrix)
+// drawn to a viewport of the given height.
+float projection_scale(float fovy, int viewport_height);
+
+// Returns the coarsest level whose error projects to at most pixel_error
+// pixels at the given distance from the camera. Use the distance to the
+// nearest point of the object's bounding sphere to be conservative.
+size_t select(const Level *levels, size_t count, float distance, float scale,
+	float pixel_error = 1.0f);
+
+}
+
+#endif
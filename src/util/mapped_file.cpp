@@ -0,0 +1,154 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+
+namespace {
+	// zero sized files can't be mapped. they get this instead so that
+	// is_open() still works.
+	const char empty_file[1] = {0};
+}
+
+MappedFile::MappedFile() : data_(0), size_(0), mapped_(false)
+{
+#ifdef _WIN32
+	file_handle_ = INVALID_HANDLE_VALUE;
+	mapping_handle_ = 0;
+#endif
+}
+
+MappedFile::MappedFile(const char *filename) : data_(0), size_(0), mapped_(false)
+{
+#ifdef _WIN32
+	file_handle_ = INVALID_HANDLE_VALUE;
+	mapping_handle_ = 0;
+#endif
+	open(filename);
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const char *filename)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(file, &size) && size.QuadPart == 0) {
+			CloseHandle(file);
+			data_ = empty_file;
+			return true;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+		const void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+		if (view) {
+			file_handle_ = file;
+			mapping_handle_ = mapping;
+			data_ = static_cast<const char*>(view);
+			size_ = static_cast<size_t>(size.QuadPart);
+			mapped_ = true;
+			return true;
+		}
+
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+	}
+#else
+	int fd = ::open(filename, O_RDONLY);
+	if (fd >= 0) {
+		struct stat st;
+		const bool have_size = fstat(fd, &st) == 0;
+		if (have_size && st.st_size == 0) {
+			::close(fd);
+			data_ = empty_file;
+			return true;
+		}
+
+		void *p = have_size ?
+			mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+
+		// the mapping holds its own reference to the file
+		::close(fd);
+
+		if (p != MAP_FAILED) {
+		#ifdef MADV_SEQUENTIAL
+			madvise(p, st.st_size, MADV_SEQUENTIAL);
+		#endif
+			data_ = static_cast<const char*>(p);
+			size_ = static_cast<size_t>(st.st_size);
+			mapped_ = true;
+			return true;
+		}
+	}
+#endif
+
+	// mapping is not possible, so try to read the whole file instead
+	FILE *f = fopen(filename, "rb");
+	if (!f) return false;
+
+	long size = -1;
+	if (fseek(f, 0, SEEK_END) == 0) size = ftell(f);
+	if (size < 0 || fseek(f, 0, SEEK_SET) != 0) {
+		fclose(f);
+		return false;
+	}
+
+	if (size == 0) {
+		fclose(f);
+		data_ = empty_file;
+		return true;
+	}
+
+	char *buffer = new char[size];
+	if (fread(buffer, 1, size, f) != static_cast<size_t>(size)) {
+		delete [] buffer;
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+
+	data_ = buffer;
+	size_ = static_cast<size_t>(size);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data_ && data_ != empty_file) {
+		if (mapped_) {
+		#ifdef _WIN32
+			UnmapViewOfFile(data_);
+			CloseHandle(mapping_handle_);
+			CloseHandle(file_handle_);
+			file_handle_ = INVALID_HANDLE_VALUE;
+			mapping_handle_ = 0;
+		#else
+			munmap(const_cast<char*>(data_), size_);
+		#endif
+		} else {
+			delete [] data_;
+		}
+	}
+
+	data_ = 0;
+	size_ = 0;
+	mapped_ = false;
+}
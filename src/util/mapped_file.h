@@ -0,0 +1,49 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <cstddef>
+
+// Read-only view of a whole file. The file is memory mapped where the
+// platform supports it, otherwise it is read into a heap buffer. Either way
+// data() stays valid until the object is closed or destroyed.
+class MappedFile {
+public:
+	MappedFile();
+	explicit MappedFile(const char *filename);
+	~MappedFile();
+
+	// Returns false if the file could not be opened.
+	bool open(const char *filename);
+	void close();
+
+	bool is_open() const
+	{ return data_ != 0; }
+
+	const char *data() const
+	{ return data_; }
+
+	size_t size() const
+	{ return size_; }
+
+private:
+	// not copyable
+	MappedFile(const MappedFile&);
+	MappedFile& operator = (const MappedFile&);
+
+	const char *data_;
+	size_t size_;
+	bool mapped_; // false if data_ was allocated with new[]
+
+#ifdef _WIN32
+	void *file_handle_;
+	void *mapping_handle_;
+#endif
+};
+
+#endif
@@ -0,0 +1,198 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#include "meshfile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+	const char MAGIC[4] = {'S', 'W', 'R', 'M'};
+	const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+	inline uint32_t align16(size_t offset)
+	{
+		return static_cast<uint32_t>((offset + 15) & ~size_t(15));
+	}
+
+	// same conversion as fixedpoint::float2fix<16>
+	inline int32_t to_fixed16(float f)
+	{
+		return static_cast<int32_t>(f * (1 << 16));
+	}
+
+	template <typename T, typename Convert>
+	void write_vertices(char *dest, const std::vector<ObjData::VertexArrayData> &vdata, Convert convert)
+	{
+		MeshFile::Vertex<T> *out = reinterpret_cast<MeshFile::Vertex<T>*>(dest);
+		for (size_t i = 0; i < vdata.size(); ++i) {
+			for (int j = 0; j < 3; ++j) {
+				out[i].position[j] = convert(vdata[i].vertex[j]);
+				out[i].normal[j] = convert(vdata[i].normal[j]);
+			}
+			for (int j = 0; j < 2; ++j)
+				out[i].texcoord[j] = convert(vdata[i].texcoord[j]);
+		}
+	}
+
+	inline float to_float(float f)
+	{
+		return f;
+	}
+
+	size_t vertex_size(uint32_t format)
+	{
+		return format == MeshFile::FORMAT_FLOAT ? sizeof(MeshFile::Vertex<float>) :
+			format == MeshFile::FORMAT_FIXED16 ? sizeof(MeshFile::Vertex<int32_t>) : 
+			sizeof(QuantizedVertex);
+	}
+
+	template <typename T>
+	bool indices_valid(const char *data, size_t count, uint32_t vertex_count)
+	{
+		const T *indices = reinterpret_cast<const T*>(data);
+		T max_index = 0;
+		for (size_t i = 0; i < count; ++i)
+			max_index = (std::max)(max_index, indices[i]);
+		return count == 0 || max_index < vertex_count;
+	}
+}
+
+MeshFile::MeshFile() : data_(0), size_(0) {}
+
+bool MeshFile::valid(const char *data, size_t size) const
+{
+	if (size < sizeof(Header)) return false;
+
+	const Header &h = *reinterpret_cast<const Header*>(data);
+	if (std::memcmp(h.magic, MAGIC, 4) != 0) return false;
+	if (h.version != VERSION || h.byte_order != BYTE_ORDER_MARK) return false;
+	if (h.vertex_format != FORMAT_FLOAT && h.vertex_format != FORMAT_FIXED16 &&
+		h.vertex_format != FORMAT_QUANTIZED) return false;
+	if (h.index_size != 2 && h.index_size != 4) return false;
+	if (h.vertex_stride < vertex_size(h.vertex_format)) return false;
+
+	// make sure the arrays are inside the file
+	const uint64_t vertex_end = h.vertex_offset + uint64_t(h.vertex_stride) * h.vertex_count;
+	const uint64_t index_end = h.index_offset + uint64_t(h.index_size) * h.index_count;
+	if ((h.vertex_offset & 15) != 0 || (h.index_offset & 15) != 0 ||
+		vertex_end > size || index_end > size)
+		return false;
+
+	// and that every index refers to a vertex
+	const char *indices = data + h.index_offset;
+	return h.index_size == 2 ?
+		indices_valid<uint16_t>(indices, h.index_count, h.vertex_count) :
+		indices_valid<uint32_t>(indices, h.index_count, h.vertex_count);
+}
+
+bool MeshFile::open(const char *filename)
+{
+	close();
+
+	if (!file_.open(filename))
+		return false;
+
+	if (!valid(file_.data(), file_.size())) {
+		file_.close();
+		return false;
+	}
+
+	data_ = file_.data();
+	size_ = file_.size();
+	return true;
+}
+
+void MeshFile::create(const std::vector<ObjData::VertexArrayData> &vdata,
+	const std::vector<unsigned> &idata, VertexFormat format, unsigned index_size)
+{
+	close();
+
+	// 0xffff is never used as a 16 bit vertex index so that it stays 
+	// available as a special value. Too many vertices for 16 bit indices
+	// always give 32 bit indices, even if 2 was requested.
+	if ((index_size != 2 && index_size != 4) || vdata.size() >= 0xffff)
+		index_size = vdata.size() < 0xffff ? 2 : 4;
+
+	std::vector<QuantizedVertex> qdata;
+	QuantizationParams params;
+	if (format == FORMAT_QUANTIZED)
+		params = quantize_vertices(vdata, qdata);
+
+	Header h;
+	std::memset(&h, 0, sizeof(h));
+	std::memcpy(h.magic, MAGIC, 4);
+	h.version = VERSION;
+	h.byte_order = BYTE_ORDER_MARK;
+	h.vertex_format = format;
+	h.vertex_stride = static_cast<uint32_t>(vertex_size(format));
+	h.vertex_count = static_cast<uint32_t>(vdata.size());
+	h.index_size = index_size;
+	h.index_count = static_cast<uint32_t>(idata.size());
+	if (format == FORMAT_QUANTIZED) {
+		for (int i = 0; i < 3; ++i) {
+			h.position_offset[i] = params.position_offset[i];
+			h.position_scale[i] = params.position_scale[i];
+		}
+		for (int i = 0; i < 2; ++i) {
+			h.texcoord_offset[i] = params.texcoord_offset[i];
+			h.texcoord_scale[i] = params.texcoord_scale[i];
+		}
+	}
+	h.vertex_offset = align16(sizeof(Header));
+	h.index_offset = align16(h.vertex_offset + h.vertex_stride * vdata.size());
+
+	buffer_.assign(h.index_offset + index_size * idata.size(), 0);
+	char *data = &buffer_[0];
+	std::memcpy(data, &h, sizeof(h));
+
+	if (format == FORMAT_FLOAT)
+		write_vertices<float>(data + h.vertex_offset, vdata, to_float);
+	else if (format == FORMAT_FIXED16)
+		write_vertices<int32_t>(data + h.vertex_offset, vdata, to_fixed16);
+	else if (!qdata.empty())
+		std::memcpy(data + h.vertex_offset, &qdata[0], qdata.size() * sizeof(QuantizedVertex));
+
+	if (index_size == 2) {
+		uint16_t *out = reinterpret_cast<uint16_t*>(data + h.index_offset);
+		for (size_t i = 0; i < idata.size(); ++i)
+			out[i] = static_cast<uint16_t>(idata[i]);
+	} else {
+		uint32_t *out = reinterpret_cast<uint32_t*>(data + h.index_offset);
+		for (size_t i = 0; i < idata.size(); ++i)
+			out[i] = idata[i];
+	}
+
+	data_ = data;
+	size_ = buffer_.size();
+}
+
+QuantizationParams MeshFile::quantization() const
+{
+	const Header &h = header();
+	QuantizationParams params;
+	params.position_offset = vmath::vec3<float>(h.position_offset[0], h.position_offset[1], h.position_offset[2]);
+	params.position_scale = vmath::vec3<float>(h.position_scale[0], h.position_scale[1], h.position_scale[2]);
+	params.texcoord_offset = vmath::vec2<float>(h.texcoord_offset[0], h.texcoord_offset[1]);
+	params.texcoord_scale = vmath::vec2<float>(h.texcoord_scale[0], h.texcoord_scale[1]);
+	return params;
+}
+
+bool MeshFile::save(const char *filename) const
+{
+	if (!data_) return false;
+
+	FILE *f = std::fopen(filename, "wb");
+	if (!f) return false;
+
+	const bool ok = std::fwrite(data_, 1, size_, f) == size_;
+	return std::fclose(f) == 0 && ok;
+}
+
+void MeshFile::close()
+{
+	file_.close();
+	buffer_.clear();
+	data_ = 0;
+	size_ = 0;
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef MESHFILE_H_
+#define MESHFILE_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "objdata.h"
+#include "mapped_file.h"
+#include "quantize.h"
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+// Binary mesh format. The vertex and index arrays are stored in exactly the
+// layout that is passed to GeometryProcessor::vertex_attrib_pointer and
+// draw_triangles. An opened file is memory mapped and used in place, so there
+// is no parsing and no conversion at load time.
+//
+// Layout: a Header followed by the vertex array and the index array, both
+// starting at a 16 byte aligned offset. Everything is in native byte order;
+// files written on a machine with different endianness are rejected.
+class MeshFile {
+public:
+	static const uint32_t VERSION = 2;
+
+	enum VertexFormat {
+		FORMAT_FLOAT = 0,  // components are 32 bit floats
+		FORMAT_FIXED16 = 1, // components are 16.16 fixed point integers
+		FORMAT_QUANTIZED = 2 // QuantizedVertex, see quantization()
+	};
+
+	// The vertex layout for the float and fixed point formats. Position and normal come first so
+	// a vertex can also be read as a struct that only has those two, e.g.
+	// { vec3<fixed_point<16> > position, normal; }.
+	template <typename T>
+	struct Vertex {
+		T position[3];
+		T normal[3];
+		T texcoord[2];
+	};
+
+	struct Header {
+		char magic[4];          // "SWRM"
+		uint32_t version;       // VERSION
+		uint32_t byte_order;    // 0x01020304 in the byte order of the writer
+		uint32_t vertex_format; // a VertexFormat
+		uint32_t vertex_stride; // size of one vertex in bytes
+		uint32_t vertex_count;
+		uint32_t index_size;    // 2 or 4 bytes
+		uint32_t index_count;
+		uint32_t vertex_offset; // offset of the vertex array from the file start
+		uint32_t index_offset;  // offset of the index array from the file start
+		float position_offset[3]; // decoding parameters for FORMAT_QUANTIZED
+		float position_scale[3];
+		float texcoord_offset[2];
+		float texcoord_scale[2];
+	};
+
+public:
+	MeshFile();
+
+	// Memory maps a mesh file. Returns false if the file can't be opened or
+	// is not a valid mesh file of this version.
+	bool open(const char *filename);
+
+	// Builds the file contents in memory from the output of
+	// ObjData::to_vertex_array. index_size is 2 or 4; pass 0 to use 16 bit
+	// indices whenever the vertex count allows it. With 0xffff or more
+	// vertices the indices are always 32 bit.
+	void create(const std::vector<ObjData::VertexArrayData> &vdata,
+		const std::vector<unsigned> &idata, VertexFormat format, unsigned index_size = 0);
+
+	// Writes the current contents to a file. Returns false on failure.
+	bool save(const char *filename) const;
+
+	void close();
+
+	bool is_open() const
+	{ return data_ != 0; }
+
+	VertexFormat vertex_format() const
+	{ return static_cast<VertexFormat>(header().vertex_format); }
+
+	unsigned vertex_stride() const
+	{ return header().vertex_stride; }
+
+	unsigned vertex_count() const
+	{ return header().vertex_count; }
+
+	const void *vertices() const
+	{ return data_ + header().vertex_offset; }
+
+	// how to decode the vertices of a FORMAT_QUANTIZED file
+	QuantizationParams quantization() const;
+
+	unsigned index_size() const
+	{ return header().index_size; }
+
+	unsigned index_count() const
+	{ return header().index_count; }
+
+	const void *indices() const
+	{ return data_ + header().index_offset; }
+
+	// typed access to the index array. returns 0 if the size does not match.
+	const uint16_t *indices16() const
+	{ return index_size() == 2 ? static_cast<const uint16_t*>(indices()) : 0; }
+
+	const uint32_t *indices32() const
+	{ return index_size() == 4 ? static_cast<const uint32_t*>(indices()) : 0; }
+
+private:
+	// not copyable
+	MeshFile(const MeshFile&);
+	MeshFile& operator = (const MeshFile&);
+
+	const Header &header() const
+	{ return *reinterpret_cast<const Header*>(data_); }
+
+	bool valid(const char *data, size_t size) const;
+
+	const char *data_;
+	size_t size_;
+
+	MappedFile file_;
+	std::vector<char> buffer_; // used by create()
+};
+
+#endif
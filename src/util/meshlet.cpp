@@ -0,0 +1,245 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#include "meshlet.h"
+#include "meshopt.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace meshlet {
+
+namespace {
+	const vmath::vec3<float>& position(const vmath::vec3<float> *positions, size_t stride, unsigned i)
+	{
+		return *reinterpret_cast<const vmath::vec3<float>*>(
+			reinterpret_cast<const char*>(positions) + i * stride);
+	}
+
+	// Computes the bounding sphere and the normal cone of the triangles
+	// indices[0 .. count - 1].
+	void compute_bounds(Meshlet &m, const unsigned *indices, size_t count,
+		const vmath::vec3<float> *positions, size_t stride)
+	{
+		using namespace vmath;
+
+		vec3<float> lo = position(positions, stride, indices[0]);
+		vec3<float> hi = lo;
+		for (size_t i = 1; i < count; ++i) {
+			const vec3<float> &p = position(positions, stride, indices[i]);
+			lo.x = (std::min)(lo.x, p.x); hi.x = (std::max)(hi.x, p.x);
+			lo.y = (std::min)(lo.y, p.y); hi.y = (std::max)(hi.y, p.y);
+			lo.z = (std::min)(lo.z, p.z); hi.z = (std::max)(hi.z, p.z);
+		}
+
+		m.bounds.center = (lo + hi) * 0.5f;
+		float r2 = 0;
+		for (size_t i = 0; i < count; ++i) {
+			const vec3<float> d = position(positions, stride, indices[i]) - m.bounds.center;
+			r2 = (std::max)(r2, dot(d, d));
+		}
+		m.bounds.radius = std::sqrt(r2);
+
+		// the axis is the average of the (unit) triangle normals, the angle
+		// the largest deviation from it
+		std::vector< vec3<float> > normals;
+		normals.reserve(count / 3);
+		vec3<float> axis(0.0f);
+		for (size_t i = 0; i + 2 < count; i += 3) {
+			const vec3<float> &p0 = position(positions, stride, indices[i + 0]);
+			const vec3<float> &p1 = position(positions, stride, indices[i + 1]);
+			const vec3<float> &p2 = position(positions, stride, indices[i + 2]);
+			const vec3<float> n = cross(p1 - p0, p2 - p0);
+			const float l = length(n);
+			if (l == 0)
+				continue; // degenerate triangles are never drawn
+			normals.push_back(n * (1.0f / l));
+			axis += normals.back();
+		}
+
+		const float l = length(axis);
+		if (normals.empty() || l == 0) {
+			m.cone_axis = vec3<float>(0, 0, 1);
+			m.cone_cutoff = 2;
+			return;
+		}
+		m.cone_axis = axis * (1.0f / l);
+
+		float min_cos = 1;
+		for (size_t i = 0; i < normals.size(); ++i)
+			min_cos = (std::min)(min_cos, dot(normals[i], m.cone_axis));
+
+		// a cone of 90 degrees or more always contains front facing normals
+		m.cone_cutoff = min_cos <= 0 ? 2 : std::sqrt(1 - min_cos * min_cos);
+	}
+
+	// Reorders the triangles of a finished meshlet for the post-transform
+	// cache. slot maps the vertices of the meshlet to 0 .. vertex count - 1,
+	// which keeps the optimization independent of the size of the mesh.
+	void optimize_meshlet(unsigned *indices, size_t count, const std::vector<unsigned> &slot,
+		const std::vector<unsigned> &meshlet_vertices)
+	{
+		std::vector<unsigned> local(count);
+		for (size_t i = 0; i < count; ++i)
+			local[i] = slot[indices[i]];
+		meshopt::optimize_vertex_cache(&local[0], count, meshlet_vertices.size());
+		for (size_t i = 0; i < count; ++i)
+			indices[i] = meshlet_vertices[local[i]];
+	}
+}
+
+void build(std::vector<Meshlet> &meshlets, unsigned *indices, size_t count,
+	const vmath::vec3<float> *positions, size_t vertex_count, size_t stride,
+	unsigned max_vertices, unsigned max_triangles)
+{
+	meshlets.clear();
+
+	// a meshlet must fit at least one triangle, otherwise no triangle is
+	// ever added and empty meshlets are closed forever
+	max_vertices = (std::max)(max_vertices, 3u);
+	max_triangles = (std::max)(max_triangles, 1u);
+
+	const size_t triangle_count = count / 3;
+	if (!triangle_count)
+		return;
+
+	// triangles using each vertex (compressed row storage)
+	std::vector<unsigned> adjacency_offset(vertex_count + 1, 0);
+	for (size_t i = 0; i < triangle_count * 3; ++i)
+		adjacency_offset[indices[i] + 1]++;
+	for (size_t i = 0; i < vertex_count; ++i)
+		adjacency_offset[i + 1] += adjacency_offset[i];
+
+	std::vector<unsigned> adjacency(triangle_count * 3);
+	{
+		std::vector<unsigned> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+		for (size_t i = 0; i < triangle_count * 3; ++i)
+			adjacency[fill[indices[i]]++] = static_cast<unsigned>(i / 3);
+	}
+
+	std::vector<bool> emitted(triangle_count, false);
+
+	// the slot of each vertex in the current meshlet, or ~0u
+	std::vector<unsigned> slot(vertex_count, ~0u);
+	std::vector<unsigned> meshlet_vertices;
+	meshlet_vertices.reserve(max_vertices);
+
+	std::vector<unsigned> result;
+	result.reserve(triangle_count * 3);
+
+	size_t next_unused = 0;
+	Meshlet m;
+	m.index_offset = 0;
+
+	for (;;) {
+		// Prefer the triangle adjacent to the meshlet which needs the
+		// fewest new vertices. Start a new meshlet with the first triangle
+		// not used yet if there is none.
+		unsigned best = ~0u;
+		unsigned best_new = 4;
+		for (size_t v = 0; v < meshlet_vertices.size() && best_new > 0; ++v) {
+			const unsigned vertex = meshlet_vertices[v];
+			for (unsigned a = adjacency_offset[vertex]; a < adjacency_offset[vertex + 1]; ++a) {
+				const unsigned t = adjacency[a];
+				if (emitted[t])
+					continue;
+				unsigned new_vertices = 0;
+				for (int k = 0; k < 3; ++k)
+					new_vertices += slot[indices[t * 3 + k]] == ~0u;
+				if (new_vertices < best_new) {
+					best_new = new_vertices;
+					best = t;
+				}
+			}
+		}
+
+		if (best == ~0u) {
+			while (next_unused < triangle_count && emitted[next_unused])
+				++next_unused;
+			if (next_unused == triangle_count)
+				break;
+			best = static_cast<unsigned>(next_unused);
+			best_new = 0;
+			for (int k = 0; k < 3; ++k)
+				best_new += slot[indices[best * 3 + k]] == ~0u;
+		}
+
+		const unsigned triangles = static_cast<unsigned>(result.size() - m.index_offset) / 3;
+		if (meshlet_vertices.size() + best_new > max_vertices || triangles + 1 > max_triangles) {
+			// close the current meshlet; the triangle goes into the next one
+			m.index_count = static_cast<unsigned>(result.size()) - m.index_offset;
+			m.vertex_count = static_cast<unsigned>(meshlet_vertices.size());
+			optimize_meshlet(&result[m.index_offset], m.index_count, slot, meshlet_vertices);
+			compute_bounds(m, &result[m.index_offset], m.index_count, positions, stride);
+			meshlets.push_back(m);
+
+			for (size_t v = 0; v < meshlet_vertices.size(); ++v)
+				slot[meshlet_vertices[v]] = ~0u;
+			meshlet_vertices.clear();
+			m.index_offset = static_cast<unsigned>(result.size());
+			continue;
+		}
+
+		for (int k = 0; k < 3; ++k) {
+			const unsigned vertex = indices[best * 3 + k];
+			if (slot[vertex] == ~0u) {
+				slot[vertex] = static_cast<unsigned>(meshlet_vertices.size());
+				meshlet_vertices.push_back(vertex);
+			}
+			result.push_back(vertex);
+		}
+		emitted[best] = true;
+	}
+
+	if (result.size() > m.index_offset) {
+		m.index_count = static_cast<unsigned>(result.size()) - m.index_offset;
+		m.vertex_count = static_cast<unsigned>(meshlet_vertices.size());
+		optimize_meshlet(&result[m.index_offset], m.index_count, slot, meshlet_vertices);
+		compute_bounds(m, &result[m.index_offset], m.index_count, positions, stride);
+		meshlets.push_back(m);
+	}
+
+	std::copy(result.begin(), result.end(), indices);
+}
+
+bool back_facing(const Meshlet &m, const vmath::vec3<float> &eye)
+{
+	// A triangle with normal n is back facing if the direction v from the
+	// eye to any of its points has dot(n, v) > 0. For all normals in the
+	// cone this holds if the angle between v and the axis is below 90
+	// degrees minus the cone angle. The sphere around the meshlet moves v
+	// by up to the radius.
+	if (m.cone_cutoff >= 1)
+		return false;
+
+	const vmath::vec3<float> d = m.bounds.center - eye;
+	const float r = m.bounds.radius;
+	return vmath::dot(d, m.cone_axis) >= m.cone_cutoff * (vmath::length(d) + r) + r;
+}
+
+size_t cull(const culling::Frustum &f, const vmath::vec3<float> &eye,
+	const Meshlet *meshlets, size_t count, unsigned *visible)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < count; ++i) {
+		if (back_facing(meshlets[i], eye))
+			continue;
+		if (!culling::test_sphere(f, meshlets[i].bounds))
+			continue;
+		visible[n++] = static_cast<unsigned>(i);
+	}
+	return n;
+}
+
+size_t gather_indices(const Meshlet *meshlets, const unsigned *visible, size_t visible_count,
+	const unsigned *indices, unsigned *out)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < visible_count; ++i) {
+		const Meshlet &m = meshlets[visible[i]];
+		std::copy(indices + m.index_offset, indices + m.index_offset + m.index_count, out + n);
+		n += m.index_count;
+	}
+	return n;
+}
+
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef MESHLET_H_
+#define MESHLET_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "culling.h"
+#include "vector_math.h"
+
+#include <vector>
+#include <cstddef>
+
+// Splits a large mesh into small clusters of triangles (meshlets) which can
+// be culled one by one before any vertex is shaded, instead of culling the
+// whole mesh or single triangles after shading.
+//
+// Typical use, after loading the mesh:
+//
+//   std::vector<meshlet::Meshlet> meshlets;
+//   meshlet::build(meshlets, &idata[0], idata.size(), &vdata[0].vertex,
+//     vdata.size(), sizeof(ObjData::VertexArrayData));
+//
+// and every frame:
+//
+//   size_t n = meshlet::cull(frustum, eye, &meshlets[0], meshlets.size(), &visible[0]);
+//   n = meshlet::gather_indices(&meshlets[0], &visible[0], n, &idata[0], &draw_indices[0]);
+//   g.draw_triangles(n, &draw_indices[0]);
+//
+// The triangles of a meshlet use few vertices, so most of them stay in the
+// post-transform cache of the vertex processor, and a meshlet is much
+// smaller than a batch of the geometry processor (1024 triangles).
+namespace meshlet {
+
+static const unsigned MAX_VERTICES = 64;
+static const unsigned MAX_TRIANGLES = 124;
+
+struct Meshlet {
+	// the triangles are indices[index_offset] .. indices[index_offset + index_count - 1]
+	unsigned index_offset;
+	unsigned index_count;
+
+	// number of different vertices used by the triangles
+	unsigned vertex_count;
+
+	culling::BoundingSphere bounds;
+
+	// All triangle normals lie within cone_angle of cone_axis. cone_cutoff
+	// is the sine of that angle, or larger than 1 if the cone is too wide
+	// for the meshlet to ever be back facing as a whole.
+	vmath::vec3<float> cone_axis;
+	float cone_cutoff;
+};
+
+// Reorders the triangles in place so that each meshlet is a contiguous
+// range of the index list and fills meshlets. Triangles are added greedily
+// to the current meshlet, preferring triangles which share vertices with it.
+// Then the triangles of each meshlet are ordered for the post-transform cache
+// with meshopt::optimize_vertex_cache.
+// The positions are count vertices which are stride bytes apart. The limits
+// are raised to at least one triangle with three vertices.
+void build(std::vector<Meshlet> &meshlets, unsigned *indices, size_t count,
+	const vmath::vec3<float> *positions, size_t vertex_count,
+	size_t stride = sizeof(vmath::vec3<float>),
+	unsigned max_vertices = MAX_VERTICES, unsigned max_triangles = MAX_TRIANGLES);
+
+// True if all triangles of the meshlet face away from the camera at eye.
+// Front faces are counter clockwise, the geometry processor's default
+// CULL_CW removes the others.
+bool back_facing(const Meshlet &m, const vmath::vec3<float> &eye);
+
+// Writes the indices of the meshlets which are in the frustum and not back
+// facing to visible, which must have space for count entries. Returns the
+// number of visible meshlets. The frustum and eye are in the space of the
+// positions: the frustum comes from the model view projection matrix and eye
+// is the camera position transformed into the model's space.
+size_t cull(const culling::Frustum &f, const vmath::vec3<float> &eye,
+	const Meshlet *meshlets, size_t count, unsigned *visible);
+
+// Copies the triangles of the visible meshlets into one index list so they
+// can be drawn with a single call. out must have space for all indices.
+// Returns the number of indices written.
+size_t gather_indices(const Meshlet *meshlets, const unsigned *visible, size_t visible_count,
+	const unsigned *indices, unsigned *out);
+
+}
+
+#endif
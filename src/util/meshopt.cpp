@@ -0,0 +1,251 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#include "meshopt.h"
+
+#include <cmath>
+
+namespace meshopt {
+
+float acmr(const unsigned *indices, size_t count)
+{
+	if (count < 3) return 0;
+
+	// same cache as in VertexProcessor::process_template
+	unsigned cache[CACHE_SIZE];
+	size_t misses = 0;
+
+	for (size_t i = 0; i < count; ++i) {
+		if (i % (FLUSH_TRIANGLES * 3) == 0) {
+			for (unsigned j = 0; j < CACHE_SIZE; ++j)
+				cache[j] = unsigned(-1);
+		}
+
+		const unsigned index = indices[i];
+		unsigned &entry = cache[index & (CACHE_SIZE - 1)];
+		if (entry != index) {
+			entry = index;
+			++misses;
+		}
+	}
+
+	return float(misses) / float(count / 3);
+}
+
+namespace {
+	// Forsyth's scoring parameters
+	const float CACHE_DECAY_POWER = 1.5f;
+	const float LAST_TRI_SCORE = 0.75f;
+	const float VALENCE_BOOST_SCALE = 2.0f;
+	const float VALENCE_BOOST_POWER = 0.5f;
+
+	// valences above this share the same boost
+	const unsigned MAX_VALENCE = 32;
+
+	struct Scores {
+		float cache[CACHE_SIZE];
+		float valence[MAX_VALENCE + 1];
+
+		Scores()
+		{
+			for (unsigned i = 0; i < CACHE_SIZE; ++i) {
+				// the vertices of the last triangle get a fixed score so
+				// that it does not matter in which order they were used.
+				if (i < 3) {
+					cache[i] = LAST_TRI_SCORE;
+				} else {
+					const float scaler = 1.0f / (CACHE_SIZE - 3);
+					cache[i] = std::pow(1.0f - (i - 3) * scaler, CACHE_DECAY_POWER);
+				}
+			}
+
+			// vertices with only a few triangles left are preferred so that
+			// they can leave the cache for good.
+			valence[0] = 0;
+			for (unsigned i = 1; i <= MAX_VALENCE; ++i)
+				valence[i] = VALENCE_BOOST_SCALE * std::pow(float(i), -VALENCE_BOOST_POWER);
+		}
+
+		float vertex(int cache_position, unsigned live_triangles) const
+		{
+			// vertices without triangles left can be ignored
+			if (live_triangles == 0) return -1.0f;
+
+			float score = cache_position >= 0 ? cache[cache_position] : 0;
+			return score + valence[live_triangles < MAX_VALENCE ? live_triangles : MAX_VALENCE];
+		}
+	};
+
+	struct VertexInfo {
+		int cache_position;      // -1 if not in the cache
+		unsigned live_triangles; // triangles that are not emitted yet
+		unsigned first_triangle; // offset into the adjacency array
+		float score;
+	};
+}
+
+void optimize_vertex_cache(unsigned *indices, size_t count, size_t vertex_count)
+{
+	const size_t triangle_count = count / 3;
+	if (triangle_count < 2) return;
+
+	static const Scores scores;
+
+	std::vector<VertexInfo> vertices(vertex_count);
+	for (size_t i = 0; i < vertex_count; ++i) {
+		vertices[i].cache_position = -1;
+		vertices[i].live_triangles = 0;
+	}
+
+	for (size_t i = 0; i < triangle_count * 3; ++i)
+		vertices[indices[i]].live_triangles++;
+
+	// the triangles of each vertex as one array. live_triangles is used
+	// as fill counter and later as the number of remaining triangles,
+	// so the not yet emitted triangles are always at the front of the list.
+	unsigned offset = 0;
+	for (size_t i = 0; i < vertex_count; ++i) {
+		vertices[i].first_triangle = offset;
+		offset += vertices[i].live_triangles;
+		vertices[i].live_triangles = 0;
+	}
+
+	std::vector<unsigned> adjacency(triangle_count * 3);
+	for (size_t t = 0; t < triangle_count; ++t) {
+		for (int k = 0; k < 3; ++k) {
+			VertexInfo &v = vertices[indices[t * 3 + k]];
+			adjacency[v.first_triangle + v.live_triangles++] = static_cast<unsigned>(t);
+		}
+	}
+
+	for (size_t i = 0; i < vertex_count; ++i)
+		vertices[i].score = scores.vertex(-1, vertices[i].live_triangles);
+
+	std::vector<float> triangle_score(triangle_count);
+	for (size_t t = 0; t < triangle_count; ++t) {
+		const unsigned *tri = indices + t * 3;
+		triangle_score[t] = vertices[tri[0]].score + vertices[tri[1]].score + vertices[tri[2]].score;
+	}
+
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<unsigned> output(triangle_count * 3);
+
+	// LRU cache model. Three extra entries hold the vertices which drop out
+	// when a triangle is added so that their scores can be updated.
+	unsigned cache[CACHE_SIZE + 3];
+	unsigned cache_count = 0;
+
+	size_t scan_position = 0;
+	size_t best = 0;
+	float best_score = triangle_score[0];
+
+	for (size_t i = 0; i < triangle_count; ++i) {
+		// nothing in the cache is adjacent to a live triangle, so take the
+		// best remaining triangle. Scanning from where the last search
+		// stopped keeps this linear overall and follows the original
+		// triangle order, which usually has some locality.
+		if (best_score < 0) {
+			while (emitted[scan_position]) ++scan_position;
+			best = scan_position;
+		}
+
+		// the geometry processor clears its cache when it flushes. do the
+		// same so that the triangles after a flush start from a good vertex.
+		if (i % FLUSH_TRIANGLES == 0 && i != 0) {
+			for (unsigned j = 0; j < cache_count; ++j) {
+				VertexInfo &v = vertices[cache[j]];
+				v.cache_position = -1;
+
+				const float score = scores.vertex(-1, v.live_triangles);
+				const unsigned *list = &adjacency[v.first_triangle];
+				for (unsigned t = 0; t < v.live_triangles; ++t)
+					triangle_score[list[t]] += score - v.score;
+				v.score = score;
+			}
+			cache_count = 0;
+		}
+
+		const unsigned *tri = indices + best * 3;
+		output[i * 3 + 0] = tri[0];
+		output[i * 3 + 1] = tri[1];
+		output[i * 3 + 2] = tri[2];
+		emitted[best] = true;
+
+		// remove the triangle from the live lists of its vertices
+		for (int k = 0; k < 3; ++k) {
+			VertexInfo &v = vertices[tri[k]];
+			unsigned *list = &adjacency[v.first_triangle];
+			for (unsigned j = 0; j < v.live_triangles; ++j) {
+				if (list[j] == best) {
+					list[j] = list[v.live_triangles - 1];
+					break;
+				}
+			}
+			v.live_triangles--;
+		}
+
+		// move the vertices of the triangle to the front of the cache
+		unsigned new_cache[CACHE_SIZE + 3];
+		unsigned new_count = 0;
+		for (int k = 0; k < 3; ++k)
+			new_cache[new_count++] = tri[k];
+		for (unsigned j = 0; j < cache_count; ++j) {
+			const unsigned index = cache[j];
+			if (index != tri[0] && index != tri[1] && index != tri[2])
+				new_cache[new_count++] = index;
+		}
+
+		// update the scores of all vertices which were or are in the cache
+		// and find the best triangle among their remaining triangles
+		best_score = -1;
+		for (unsigned j = 0; j < new_count; ++j) {
+			const unsigned index = new_cache[j];
+			VertexInfo &v = vertices[index];
+			v.cache_position = j < CACHE_SIZE ? int(j) : -1;
+
+			const float score = scores.vertex(v.cache_position, v.live_triangles);
+			const float delta = score - v.score;
+			v.score = score;
+
+			const unsigned *list = &adjacency[v.first_triangle];
+			for (unsigned t = 0; t < v.live_triangles; ++t) {
+				const unsigned tri_index = list[t];
+				triangle_score[tri_index] += delta;
+				if (triangle_score[tri_index] > best_score) {
+					best_score = triangle_score[tri_index];
+					best = tri_index;
+				}
+			}
+		}
+
+		cache_count = new_count < CACHE_SIZE ? new_count : CACHE_SIZE;
+		for (unsigned j = 0; j < cache_count; ++j)
+			cache[j] = new_cache[j];
+	}
+
+	for (size_t i = 0; i < triangle_count * 3; ++i)
+		indices[i] = output[i];
+}
+
+size_t optimize_vertex_fetch(std::vector<unsigned> &remap, unsigned *indices,
+	size_t count, size_t vertex_count)
+{
+	remap.assign(vertex_count, unsigned(-1));
+
+	unsigned next = 0;
+	for (size_t i = 0; i < count; ++i) {
+		unsigned &r = remap[indices[i]];
+		if (r == unsigned(-1))
+			r = next++;
+		indices[i] = r;
+	}
+
+	const size_t used = next;
+	for (size_t i = 0; i < vertex_count; ++i) {
+		if (remap[i] == unsigned(-1))
+			remap[i] = next++;
+	}
+
+	return used;
+}
+
+} // end namespace meshopt
@@ -0,0 +1,64 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef MESHOPT_H_
+#define MESHOPT_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include <vector>
+#include <cstddef>
+
+// Index and vertex reordering for indexed triangle lists, tuned for the
+// post-transform cache of swr::VertexProcessor. That cache has 16 entries,
+// is direct mapped on (index & 15) and is cleared whenever the geometry
+// processor flushes its triangle buffer (every 1024 triangles).
+//
+// Typical use after loading a mesh:
+//
+//   meshopt::optimize_vertex_cache(&idata[0], idata.size(), vdata.size());
+//   meshopt::optimize_vertex_fetch(remap, &idata[0], idata.size(), vdata.size());
+//   meshopt::remap_vertices(vdata, remap);
+//
+// The second step also matters for the cache: when vertices are numbered in
+// the order they are first used, consecutive new vertices land in
+// consecutive cache slots and the direct mapped cache behaves like a FIFO,
+// which is the model the triangle order was optimized for.
+namespace meshopt {
+
+static const unsigned CACHE_SIZE = 16;
+static const unsigned FLUSH_TRIANGLES = 1024;
+
+// Average cache miss ratio: the number of vertex shader invocations per
+// triangle when drawing the index list with swr::VertexProcessor. Lies
+// between 0.5 (best case for large meshes) and 3.
+float acmr(const unsigned *indices, size_t count);
+
+// Reorders the triangles in place for better post-transform cache use
+// (the algorithm from Tom Forsyth's "Linear-Speed Vertex Cache
+// Optimisation"). vertex_count must be larger than every index.
+void optimize_vertex_cache(unsigned *indices, size_t count, size_t vertex_count);
+
+// Renumbers the vertices in the order they are first referenced so that
+// vertex fetches walk through memory linearly. The indices are rewritten in
+// place and remap[old_index] receives the new index of every vertex.
+// Unreferenced vertices are moved to the end. Returns the number of
+// referenced vertices.
+size_t optimize_vertex_fetch(std::vector<unsigned> &remap, unsigned *indices,
+	size_t count, size_t vertex_count);
+
+// Moves the vertices to the positions given by a remap table from
+// optimize_vertex_fetch.
+template <typename T>
+void remap_vertices(std::vector<T> &vertices, const std::vector<unsigned> &remap)
+{
+	std::vector<T> tmp(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+		tmp[remap[i]] = vertices[i];
+	vertices.swap(tmp);
+}
+
+} // end namespace meshopt
+
+#endif
@@ -31,94 +31,257 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "objdata.h"
+#include "mapped_file.h"
 
-#include <fstream>
-#include <string>
-#include <sstream>
-
-#include <iostream>
 #include <map>
+#include <stdint.h>
 
 using namespace std;
 
 typedef vmath::vec3<float> vec3f;
 typedef vmath::vec2<float> vec2f;
 
-// string is supposed to be in the form <vertex_index>/<texture_index>/<normal_index>, 
-void extract_indices_from_string(string str, unsigned &vi, unsigned &ni, unsigned &ti)
-{
-	string v;
-	string t;
-	string n;
-
-	string *tmp[3] = {&v, &t, &n};
-	
-	int tidx = 0;
-	string *target = tmp[0];
-	
-	for (size_t i = 0; i < str.size(); ++i) {
-		if (str[i] == '/') target = tmp[++tidx];
-		else *target += str[i];
+namespace internal {
+	// The parser works directly on the mapped file contents. All functions
+	// take the current position and the end of the buffer and return the
+	// position after what was consumed. Nothing here allocates.
+
+	inline bool is_blank(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
 	}
 
-	istringstream iss1(v);
-	vi = 0;
-	iss1 >> vi;
+	inline bool is_digit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	inline const char *skip_blanks(const char *p, const char *end)
+	{
+		while (p != end && is_blank(*p)) ++p;
+		return p;
+	}
 
-	istringstream iss2(t);
-	ti = 0;
-	iss2 >> ti;
+	// returns the position after the next newline
+	inline const char *skip_line(const char *p, const char *end)
+	{
+		while (p != end && *p != '\n') ++p;
+		return p == end ? p : p + 1;
+	}
+
+	inline const char *parse_unsigned(const char *p, const char *end, unsigned &result)
+	{
+		unsigned r = 0;
+		while (p != end && is_digit(*p))
+			r = r * 10 + (*p++ - '0');
+		result = r;
+		return p;
+	}
+
+	// Parses a decimal floating point number with an optional exponent.
+	// Leaves the value at 0 if there is no number at p.
+	const char *parse_float(const char *p, const char *end, float &result)
+	{
+		// powers of ten that are exactly representable as a double
+		static const double pow10[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+
+		bool negative = false;
+		if (p != end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+		// collect up to 19 significant digits, which always fit the mantissa
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+
+		for (; p != end && is_digit(*p); ++p) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa) ++digits;
+			} else {
+				++exponent;
+			}
+		}
+
+		if (p != end && *p == '.') {
+			for (++p; p != end && is_digit(*p); ++p) {
+				if (digits < 19) {
+					mantissa = mantissa * 10 + (*p - '0');
+					if (mantissa) ++digits;
+					--exponent;
+				}
+			}
+		}
+
+		if (p != end && (*p == 'e' || *p == 'E')) {
+			const char *q = p + 1;
+			bool negative_exponent = false;
+			if (q != end && (*q == '-' || *q == '+')) negative_exponent = *q++ == '-';
+
+			if (q != end && is_digit(*q)) {
+				unsigned e;
+				p = parse_unsigned(q, end, e);
+				if (e > 1000) e = 1000;
+				exponent += negative_exponent ? -static_cast<int>(e) : static_cast<int>(e);
+			}
+		}
+
+		double value = static_cast<double>(mantissa);
+		if (mantissa) {
+			while (exponent > 22) { value *= 1e22; exponent -= 22; }
+			while (exponent < -22) { value /= 1e22; exponent += 22; }
+			if (exponent >= 0) value *= pow10[exponent];
+			else value /= pow10[-exponent];
+		}
+
+		result = static_cast<float>(negative ? -value : value);
+		return p;
+	}
 
-	istringstream iss3(n);
-	ni = 0;
-	iss3 >> ni;
+	// parses a vertex reference in the form 
+	// <vertex_index>/<texture_index>/<normal_index>. 
+	// Missing indices are set to 0.
+	inline const char *parse_vertex_ref(const char *p, const char *end, ObjData::VertexRef &vr)
+	{
+		vr.texcoord_index = 0;
+		vr.normal_index = 0;
+
+		p = parse_unsigned(p, end, vr.vertex_index);
+		if (p != end && *p == '/') {
+			p = parse_unsigned(p + 1, end, vr.texcoord_index);
+			if (p != end && *p == '/')
+				p = parse_unsigned(p + 1, end, vr.normal_index);
+		}
+
+		// skip anything not understood (e.g. negative indices)
+		while (p != end && !is_blank(*p) && *p != '\n') ++p;
+		return p;
+	}
+
+	template <typename Vec>
+	const char *parse_floats(const char *p, const char *end, Vec &v, int count)
+	{
+		for (int i = 0; i < count; ++i) {
+			v[i] = 0.0f;
+			p = parse_float(skip_blanks(p, end), end, v[i]);
+		}
+		return p;
+	}
+
+	// parses the lines in [p, end) and appends the data to result
+	void parse(const char *p, const char *end, ObjData &result)
+	{
+		while (p != end) {
+			p = skip_blanks(p, end);
+			if (p == end) break;
+
+			const char c0 = *p;
+			const char c1 = p + 1 != end ? p[1] : '\n';
+
+			if (c0 == 'v' && is_blank(c1)) {
+				vec3f v;
+				p = parse_floats(p + 1, end, v, 3);
+				result.vertices.push_back(v);
+			} else if (c0 == 'v' && c1 == 'n') {
+				vec3f v;
+				p = parse_floats(p + 2, end, v, 3);
+				result.normals.push_back(v);
+			} else if (c0 == 'v' && c1 == 't') {
+				vec2f t;
+				p = parse_floats(p + 2, end, t, 2);
+				result.texcoords.push_back(t);
+			} else if (c0 == 'f' && is_blank(c1)) {
+				result.faces.push_back(ObjData::Face());
+				ObjData::Face &face = result.faces.back();
+				face.reserve(4);
+
+				p = skip_blanks(p + 1, end);
+				while (p != end && *p != '\n') {
+					ObjData::VertexRef vr;
+					p = skip_blanks(parse_vertex_ref(p, end, vr), end);
+					face.push_back(vr);
+				}
+			}
+
+			p = skip_line(p, end);
+		}
+	}
 }
 
-ObjData ObjData::load_from_file(const char *filename)
+ObjData ObjData::load_from_file(const char *filename, int thread_count)
+{
+	MappedFile file(filename);
+	return load_from_memory(file.data(), file.size(), thread_count);
+}
+
+ObjData ObjData::load_from_memory(const char *data, size_t size, int thread_count)
 {
 	ObjData result;
 	result.vertices.push_back(vec3f(0.0f));
 	result.normals.push_back(vec3f(0.0f));
 	result.texcoords.push_back(vec2f(0.0));
 
-	ifstream in(filename, ios::in);
-	while (in) {
-		string line;
-		getline(in, line);
-		istringstream iss;
-		iss.str(line);
-		string cmd;
-		iss >> cmd;
-		
-		if (cmd[0] == '#') continue;
-		else if (cmd == "v") {
-			vec3f v;
-			iss >> v.x >> v.y >> v.z;
-			result.vertices.push_back(v);
-		} else if (cmd == "vn") {
-			vec3f v;
-			iss >> v.x >> v.y >> v.z;
-			result.normals.push_back(v);
-		} else if (cmd == "vt") {
-			vec2f t;
-			iss >> t.x >> t.y;
-			result.texcoords.push_back(t);
-		} else if (cmd == "f") {
-			result.faces.push_back(ObjData::Face());
-			ObjData::Face &face = result.faces.back();
-			
-			while (iss) {
-				string word;
-				iss >> word;
-
-				if (word == "") continue;
-				
-				ObjData::VertexRef vr;
-				extract_indices_from_string(word, vr.vertex_index, vr.normal_index, vr.texcoord_index);
-
-				face.push_back(vr);
-			}
-		}
+	if (!data || !size)
+		return result;
+
+	const char *end = data + size;
+
+	// don't bother splitting small files
+	static const size_t MIN_CHUNK_SIZE = 64 * 1024;
+	if (thread_count > static_cast<int>(size / MIN_CHUNK_SIZE))
+		thread_count = static_cast<int>(size / MIN_CHUNK_SIZE);
+
+	if (thread_count <= 1) {
+		internal::parse(data, end, result);
+		return result;
+	}
+
+	// split into chunks which start at the beginning of a line
+	vector<const char*> bounds(thread_count + 1);
+	bounds[0] = data;
+	bounds[thread_count] = end;
+	for (int i = 1; i < thread_count; ++i) {
+		const char *p = data + size / thread_count * i;
+		if (p < bounds[i - 1]) p = bounds[i - 1];
+		bounds[i] = p == data ? p : internal::skip_line(p - 1, end);
+	}
+
+	vector<ObjData> chunks(thread_count);
+
+	#pragma omp parallel for num_threads(thread_count)
+	for (int i = 0; i < thread_count; ++i)
+		internal::parse(bounds[i], bounds[i + 1], chunks[i]);
+
+	// indices in the faces are absolute, so the chunks can just be appended
+	// in file order.
+	size_t vertex_count = result.vertices.size();
+	size_t normal_count = result.normals.size();
+	size_t texcoord_count = result.texcoords.size();
+	size_t face_count = 0;
+	for (int i = 0; i < thread_count; ++i) {
+		vertex_count += chunks[i].vertices.size();
+		normal_count += chunks[i].normals.size();
+		texcoord_count += chunks[i].texcoords.size();
+		face_count += chunks[i].faces.size();
+	}
+
+	result.vertices.reserve(vertex_count);
+	result.normals.reserve(normal_count);
+	result.texcoords.reserve(texcoord_count);
+	result.faces.resize(face_count);
+
+	size_t face_index = 0;
+	for (int i = 0; i < thread_count; ++i) {
+		ObjData &c = chunks[i];
+		result.vertices.insert(result.vertices.end(), c.vertices.begin(), c.vertices.end());
+		result.normals.insert(result.normals.end(), c.normals.begin(), c.normals.end());
+		result.texcoords.insert(result.texcoords.end(), c.texcoords.begin(), c.texcoords.end());
+
+		// swap instead of copy to avoid reallocating every face
+		for (size_t j = 0; j < c.faces.size(); ++j)
+			result.faces[face_index++].swap(c.faces[j]);
 	}
 
 	return result;
@@ -140,29 +303,118 @@ namespace internal {
 			}
 		}
 	};
-}
 
-using namespace internal;
+	// Maps vertex references to output indices using a std::map. This was
+	// the original implementation and is kept for comparison.
+	class VertexRefMap {
+		typedef map<ObjData::VertexRef, unsigned, VertexRefCompare> map_t;
+		map_t map_;
 
-void ObjData::to_vertex_array(std::vector<VertexArrayData> &vdata, std::vector<unsigned> &idata)
-{
-	vdata.clear();
-	idata.clear();
+	public:
+		explicit VertexRefMap(size_t /*expected_size*/) {}
+
+		// Returns the index stored for v. If v is not in the map yet it is
+		// inserted with the given index.
+		unsigned find_or_insert(const ObjData::VertexRef &v, unsigned index)
+		{
+			return map_.insert(make_pair(v, index)).first->second;
+		}
+	};
+
+	// Open addressing hash table with linear probing. The initial size is
+	// chosen from the expected number of entries and the table is doubled
+	// when it gets more than half full.
+	class VertexRefHashMap {
+		struct Entry {
+			ObjData::VertexRef key;
+			unsigned value;
+		};
+
+		static const unsigned EMPTY = static_cast<unsigned>(-1);
+
+		vector<Entry> table_;
+		size_t mask_;
+		size_t size_;
+
+		static unsigned hash(const ObjData::VertexRef &v)
+		{
+			unsigned h = v.vertex_index * 0x9e3779b1u;
+			h ^= v.normal_index * 0x85ebca77u;
+			h ^= v.texcoord_index * 0xc2b2ae3du;
+			return h ^ (h >> 16);
+		}
+
+		static bool equal(const ObjData::VertexRef &a, const ObjData::VertexRef &b)
+		{
+			return a.vertex_index == b.vertex_index && 
+				a.normal_index == b.normal_index &&
+				a.texcoord_index == b.texcoord_index;
+		}
+
+		void allocate(size_t capacity)
+		{
+			Entry empty;
+			empty.value = EMPTY;
+
+			vector<Entry> old;
+			old.swap(table_);
+			table_.resize(capacity, empty);
+			mask_ = capacity - 1;
+
+			for (size_t i = 0; i < old.size(); ++i) {
+				if (old[i].value == EMPTY) continue;
+				size_t j = hash(old[i].key) & mask_;
+				while (table_[j].value != EMPTY) j = (j + 1) & mask_;
+				table_[j] = old[i];
+			}
+		}
+
+	public:
+		explicit VertexRefHashMap(size_t expected_size) : size_(0)
+		{
+			size_t capacity = 16;
+			while (capacity < expected_size * 2) capacity *= 2;
+			allocate(capacity);
+		}
+
+		unsigned find_or_insert(const ObjData::VertexRef &v, unsigned index)
+		{
+			for (size_t i = hash(v) & mask_; ; i = (i + 1) & mask_) {
+				Entry &e = table_[i];
+				if (e.value == EMPTY) {
+					e.key = v;
+					e.value = index;
+					if (++size_ * 2 > table_.size())
+						allocate(table_.size() * 2);
+					return index;
+				}
+
+				if (equal(e.key, v))
+					return e.value;
+			}
+		}
+	};
+
+	template <typename IndexMap>
+	struct VertexArrayBuilder {
+		typedef ObjData::VertexRef VertexRef;
+		typedef ObjData::VertexArrayData VertexArrayData;
 
-	struct Helper {
 		vector<VertexArrayData> &vdata_;
 		vector<unsigned> &idata_;
 		const ObjData &obj_;
 
-		typedef map<VertexRef, unsigned, internal::VertexRefCompare> vertex_index_map_t;
-		vertex_index_map_t vertex_index_map;
+		IndexMap vertex_index_map;
 
-		Helper(const ObjData& obj, std::vector<VertexArrayData> &vdata, std::vector<unsigned> &idata):
-			vdata_(vdata), idata_(idata), obj_(obj) {}
+		VertexArrayBuilder(const ObjData& obj, size_t expected_vertices,
+			vector<VertexArrayData> &vdata, vector<unsigned> &idata):
+			vdata_(vdata), idata_(idata), obj_(obj), vertex_index_map(expected_vertices) {}
 
 		void process() 
 		{
 			for (size_t i = 0; i < obj_.faces.size(); ++i) {
+				if (obj_.faces[i].empty()) continue;
+
 				unsigned i1 = add_vertex(obj_.faces[i][0]);
 
 				// make a triangle fan if there are more than 3 vertices
@@ -177,15 +429,13 @@ void ObjData::to_vertex_array(std::vector<VertexArrayData> &vdata, std::vector<u
 
 		unsigned add_vertex(const VertexRef &v) 
 		{
-			// check if this vertex already exists
-			vertex_index_map_t::const_iterator it = vertex_index_map.find(v);
-			if (it != vertex_index_map.end()) 
-				return it->second;
+			// returns the existing index if the vertex is already known
+			unsigned i = static_cast<unsigned>(vdata_.size());
+			unsigned existing = vertex_index_map.find_or_insert(v, i);
+			if (existing != i) 
+				return existing;
 
 			// does not exist, so insert a new one
-			unsigned i = static_cast<unsigned>(vertex_index_map.size());
-			vertex_index_map.insert(make_pair(v, i));
-
 			VertexArrayData vd;
 			vd.vertex = obj_.vertices[v.vertex_index];
 			vd.normal = obj_.normals[v.normal_index];
@@ -201,8 +451,34 @@ void ObjData::to_vertex_array(std::vector<VertexArrayData> &vdata, std::vector<u
 			idata_.push_back(i2);
 			idata_.push_back(i3);
 		}
+	};
+}
+
+using namespace internal;
+
+void ObjData::to_vertex_array(std::vector<VertexArrayData> &vdata, std::vector<unsigned> &idata,
+	DedupMethod method)
+{
+	vdata.clear();
+	idata.clear();
+
+	size_t index_count = 0;
+	for (size_t i = 0; i < faces.size(); ++i) {
+		if (faces[i].size() >= 3)
+			index_count += (faces[i].size() - 2) * 3;
+	}
+
+	// usually there are about as many unique vertices as positions
+	const size_t expected_vertices = vertices.size();
 
-	} helper(*this, vdata, idata);
+	idata.reserve(index_count);
+	vdata.reserve(expected_vertices);
 
-	helper.process();
+	if (method == DEDUP_MAP) {
+		VertexArrayBuilder<VertexRefMap> builder(*this, expected_vertices, vdata, idata);
+		builder.process();
+	} else {
+		VertexArrayBuilder<VertexRefHashMap> builder(*this, expected_vertices, vdata, idata);
+		builder.process();
+	}
 }
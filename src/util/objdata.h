@@ -35,6 +35,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "vector_math.h"
 #include <vector>
+#include <cstddef>
 
 // Use this class to load Obj files from disk 
 // and convert them to vertex arrays.
@@ -58,11 +59,25 @@ struct ObjData {
 	std::vector< vmath::vec2<float> > texcoords;
 	std::vector<Face> faces;
 
-	// Load the .obj file
-	static ObjData load_from_file(const char *filename);
+	// Load the .obj file. The file is memory mapped and parsed in place. With
+	// a thread_count > 1 it is split into that many chunks at line boundaries
+	// which are parsed in parallel (requires OpenMP, otherwise the chunks are
+	// parsed one after another).
+	static ObjData load_from_file(const char *filename, int thread_count = 1);
+
+	// Same as above but parses .obj data which is already in memory. The data
+	// does not need to be null terminated.
+	static ObjData load_from_memory(const char *data, size_t size, int thread_count = 1);
+
+	// How to_vertex_array finds vertices which are referenced more than once.
+	enum DedupMethod {
+		DEDUP_HASH, // open addressing hash table
+		DEDUP_MAP   // std::map, the slower original implementation
+	};
 
 	// Convert to vertex and index array
-	void to_vertex_array(std::vector<VertexArrayData> &vdata, std::vector<unsigned> &idata);
+	void to_vertex_array(std::vector<VertexArrayData> &vdata, std::vector<unsigned> &idata, 
+		DedupMethod method = DEDUP_HASH);
 };
 
 #endif
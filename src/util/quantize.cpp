@@ -0,0 +1,103 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#include "quantize.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace vmath;
+
+namespace {
+	const int QUANT_MAX = 32767;
+
+	// smallest power of two step that covers [-half_range, half_range] with
+	// QUANT_MAX steps in each direction. Steps below 2^-16 can't be
+	// represented in 16.16 fixed point, so that is the lower limit.
+	float quantization_step(float half_range)
+	{
+		const float min_step = 1.0f / 65536;
+		float step = min_step;
+		while (step * QUANT_MAX < half_range)
+			step *= 2;
+		return step;
+	}
+
+	int round_to_int(float f)
+	{
+		return static_cast<int>(std::floor(f + 0.5f));
+	}
+
+	short quantize(float v, float offset, float step)
+	{
+		int q = round_to_int((v - offset) / step);
+		if (q > QUANT_MAX) q = QUANT_MAX;
+		if (q < -QUANT_MAX) q = -QUANT_MAX;
+		return static_cast<short>(q);
+	}
+
+	signed char quantize_snorm8(float f)
+	{
+		int q = round_to_int(f * 127);
+		if (q > 127) q = 127;
+		if (q < -127) q = -127;
+		return static_cast<signed char>(q);
+	}
+}
+
+QuantizationParams quantize_vertices(const std::vector<ObjData::VertexArrayData> &vdata,
+	std::vector<QuantizedVertex> &qdata)
+{
+	QuantizationParams params;
+	qdata.resize(vdata.size());
+
+	if (vdata.empty()) {
+		params.position_offset = vec3<float>(0.0f);
+		params.position_scale = vec3<float>(1.0f);
+		params.texcoord_offset = vec2<float>(0.0f);
+		params.texcoord_scale = vec2<float>(1.0f);
+		return params;
+	}
+
+	// bounding boxes of positions and texture coordinates
+	vec3<float> pmin = vdata[0].vertex, pmax = vdata[0].vertex;
+	vec2<float> tmin = vdata[0].texcoord, tmax = vdata[0].texcoord;
+	for (size_t i = 1; i < vdata.size(); ++i) {
+		const ObjData::VertexArrayData &v = vdata[i];
+		for (int j = 0; j < 3; ++j) {
+			pmin[j] = std::min(pmin[j], v.vertex[j]);
+			pmax[j] = std::max(pmax[j], v.vertex[j]);
+		}
+		for (int j = 0; j < 2; ++j) {
+			tmin[j] = std::min(tmin[j], v.texcoord[j]);
+			tmax[j] = std::max(tmax[j], v.texcoord[j]);
+		}
+	}
+
+	for (int j = 0; j < 3; ++j) {
+		params.position_offset[j] = (pmin[j] + pmax[j]) * 0.5f;
+		params.position_scale[j] = quantization_step((pmax[j] - pmin[j]) * 0.5f);
+	}
+	for (int j = 0; j < 2; ++j) {
+		params.texcoord_offset[j] = (tmin[j] + tmax[j]) * 0.5f;
+		params.texcoord_scale[j] = quantization_step((tmax[j] - tmin[j]) * 0.5f);
+	}
+
+	for (size_t i = 0; i < vdata.size(); ++i) {
+		const ObjData::VertexArrayData &v = vdata[i];
+		QuantizedVertex &q = qdata[i];
+
+		for (int j = 0; j < 3; ++j)
+			q.position[j] = quantize(v.vertex[j], params.position_offset[j], params.position_scale[j]);
+		for (int j = 0; j < 2; ++j)
+			q.texcoord[j] = quantize(v.texcoord[j], params.texcoord_offset[j], params.texcoord_scale[j]);
+
+		// degenerated normals are stored as pointing in z direction
+		vec2<float> n(0.0f, 0.0f);
+		if (dot(v.normal, v.normal) > 0)
+			n = oct_encode(normalize(v.normal));
+		q.normal[0] = quantize_snorm8(n.x);
+		q.normal[1] = quantize_snorm8(n.y);
+	}
+
+	return params;
+}
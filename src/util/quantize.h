@@ -0,0 +1,44 @@
+// Copyright (c) 2012 Markus Trenkwalder
+
+#ifndef QUANTIZE_H_
+#define QUANTIZE_H_
+
+#if defined (_MSC_VER) && (_MSC_VER >= 1020)
+#pragma once
+#endif
+
+#include "objdata.h"
+#include "vector_math.h"
+
+#include <vector>
+
+// A vertex with quantized attributes. 12 bytes instead of the 32 bytes of
+// float or 16.16 fixed point position, normal and texture coordinates.
+//
+// position: 16 bit per component relative to the center of the bounding box
+// normal:   octahedral encoding with 8 bit per component
+// texcoord: 16 bit per component relative to the center of the used range
+//
+// Use vmath::dequantize and vmath::oct_decode to get the values back.
+struct QuantizedVertex {
+	short position[3];
+	signed char normal[2];
+	short texcoord[2];
+};
+
+// What is needed to decode the positions and texture coordinates of a
+// quantized mesh. The scales are powers of two (and at least 2^-16) so that
+// decoding is exact when done in 16.16 fixed point.
+struct QuantizationParams {
+	vmath::vec3<float> position_offset;
+	vmath::vec3<float> position_scale;
+	vmath::vec2<float> texcoord_offset;
+	vmath::vec2<float> texcoord_scale;
+};
+
+// Quantizes the output of ObjData::to_vertex_array. Returns the parameters
+// needed for decoding.
+QuantizationParams quantize_vertices(const std::vector<ObjData::VertexArrayData> &vdata,
+	std::vector<QuantizedVertex> &qdata);
+
+#endif
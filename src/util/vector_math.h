@@ -272,6 +272,72 @@ template <typename T> inline vec3<T> cross(const vec3<T>& u, const vec3<T>& v)
 		dot(vec2<T>(u.x, -v.x), vec2<T>(v.y, u.y)));
 }
 
+// Decoding of quantized vertex attributes. The quantized value q is turned
+// back into offset + q * scale. With a power of two scale this is exact for
+// fixed point types too.
+template <typename T>
+inline vec2<T> dequantize(const short q[2], const vec2<T>& offset, const vec2<T>& scale)
+{
+	return vec2<T>(
+		offset.x + scale.x * int(q[0]),
+		offset.y + scale.y * int(q[1]));
+}
+
+template <typename T>
+inline vec3<T> dequantize(const short q[3], const vec3<T>& offset, const vec3<T>& scale)
+{
+	return vec3<T>(
+		offset.x + scale.x * int(q[0]),
+		offset.y + scale.y * int(q[1]),
+		offset.z + scale.z * int(q[2]));
+}
+
+// Octahedral normal encoding. The unit sphere is projected onto an
+// octahedron which is then unfolded into the square [-1,1]x[-1,1]. Only
+// comparisons are used so this works with fixed point types as well.
+template <typename T>
+inline vec2<T> oct_encode(const vec3<T>& n)
+{
+	const T zero = T(0), one = T(1);
+	const T ax = n.x < zero ? -n.x : n.x;
+	const T ay = n.y < zero ? -n.y : n.y;
+	const T az = n.z < zero ? -n.z : n.z;
+	const T s = ax + ay + az;
+
+	vec2<T> p(n.x / s, n.y / s);
+	if (n.z < zero) {
+		// fold the lower half over the diagonals
+		const T px = p.x < zero ? -p.x : p.x;
+		const T py = p.y < zero ? -p.y : p.y;
+		p.x = p.x < zero ? py - one : one - py;
+		p.y = p.y < zero ? px - one : one - px;
+	}
+	return p;
+}
+
+template <typename T>
+inline vec3<T> oct_decode(const vec2<T>& p)
+{
+	const T zero = T(0), one = T(1);
+	const T ax = p.x < zero ? -p.x : p.x;
+	const T ay = p.y < zero ? -p.y : p.y;
+
+	vec3<T> n(p.x, p.y, one - ax - ay);
+	if (n.z < zero) {
+		// unfold the lower half
+		n.x = p.x < zero ? ay - one : one - ay;
+		n.y = p.y < zero ? ax - one : one - ax;
+	}
+	return normalize(n);
+}
+
+// Decodes a normal which was stored as two signed bytes (oct_encode scaled by 127).
+template <typename T>
+inline vec3<T> oct_decode(const signed char q[2])
+{
+	return oct_decode(vec2<T>(T(int(q[0])) / 127, T(int(q[1])) / 127));
+}
+
 
 #define MATRIX_COL4(SRC, C) \
 	vec4<T>(SRC.elem[0][C], SRC.elem[1][C], SRC.elem[2][C], SRC.elem[3][C])